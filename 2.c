@@ -1,6 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #pragma pack(push, 1)
 typedef struct {
@@ -26,51 +34,621 @@ typedef struct {
 } BMPInfoHeader;
 #pragma pack(pop)
 
-void draw_line(unsigned char* pixel_data, int width, int height, int x1, int y1, int x2, int y2, unsigned char r, unsigned char g, unsigned char b) {
-    int dx = abs(x2 - x1), dy = abs(y2 - y1);
+size_t get_row_size(int width) {
+    return (((size_t)width * 3 + 3) / 4) * 4;
+}
+
+/* окно в пиксели: data - строка y = 0 (верхняя), stride - шаг между строками в байтах,
+   bpp - байт на пиксель. В BMP строки хранятся снизу вверх, у такого окна stride < 0 */
+typedef struct {
+    unsigned char* data;
+    int width;
+    int height;
+    ptrdiff_t stride;
+    int bpp;
+} ImageView;
+
+/* 24-битные пиксели BMP; height < 0 - строки сверху вниз */
+ImageView bmp_view(unsigned char* pixels, int width, int height) {
+    ImageView view = {pixels, width, abs(height), (ptrdiff_t)get_row_size(width), 3};
+    if (height > 0) {
+        view.data = pixels + (ptrdiff_t)(height - 1) * view.stride;
+        view.stride = -view.stride;
+    }
+    return view;
+}
+
+static inline ptrdiff_t pixel_offset(const ImageView* view, int x, int y) {
+    return (ptrdiff_t)y * view->stride + (ptrdiff_t)x * view->bpp;
+}
+
+static inline void put_pixel(unsigned char* p, unsigned char r, unsigned char g, unsigned char b) {
+    p[0] = b;
+    p[1] = g;
+    p[2] = r;
+}
+
+/* отрезок строки y от x1 до x2 включительно: серый - одним memset, иначе первый пиксель
+   размножается memcpy удвоением, и копирование идёт большими блоками */
+void fill_hspan(const ImageView* view, int y, int x1, int x2, unsigned char r, unsigned char g, unsigned char b) {
+    if (x1 > x2) { int t = x1; x1 = x2; x2 = t; }
+    if (y < 0 || y >= view->height || x2 < 0 || x1 >= view->width) return;
+    if (x1 < 0) x1 = 0;
+    if (x2 >= view->width) x2 = view->width - 1;
+
+    unsigned char* p = view->data + pixel_offset(view, x1, y);
+    size_t n = (size_t)(x2 - x1 + 1);
+    if (view->bpp != 3) {
+        for (size_t i = 0; i < n; ++i) {
+            put_pixel(p + i * view->bpp, r, g, b);
+        }
+        return;
+    }
+    if (r == g && g == b) {
+        memset(p, b, n * 3);
+        return;
+    }
+    put_pixel(p, r, g, b);
+    for (size_t done = 1; done < n;) {
+        size_t chunk = done < n - done ? done : n - done;
+        memcpy(p + done * 3, p, chunk * 3);
+        done += chunk;
+    }
+}
+
+/* отрезок столбца x от y1 до y2 включительно: умножений нет, только шаг stride */
+void fill_vspan(const ImageView* view, int x, int y1, int y2, unsigned char r, unsigned char g, unsigned char b) {
+    if (y1 > y2) { int t = y1; y1 = y2; y2 = t; }
+    if (x < 0 || x >= view->width || y2 < 0 || y1 >= view->height) return;
+    if (y1 < 0) y1 = 0;
+    if (y2 >= view->height) y2 = view->height - 1;
+
+    unsigned char* p = view->data + pixel_offset(view, x, y1);
+    for (int y = y1; y <= y2; ++y, p += view->stride) {
+        put_pixel(p, r, g, b);
+    }
+}
+
+/* часть отрезка в строках first..last (first <= last) - те же пиксели, что дал бы
+   Брезенхем по всему отрезку. Состояние на шаге k считается сразу: по главной оси каждый
+   шаг сдвигает на 1, по второй сдвигов ceil(...), ошибка восстанавливается из них */
+void draw_line_rows(const ImageView* view, int x1, int y1, int x2, int y2,
+                    unsigned char r, unsigned char g, unsigned char b, int first, int last) {
+    int top = y1 < y2 ? y1 : y2;
+    int bottom = y1 < y2 ? y2 : y1;
+    if (first < top) first = top;
+    if (last > bottom) last = bottom;
+    if (first < 0) first = 0;
+    if (last >= view->height) last = view->height - 1;
+    if (first > last) return;
+
+    if (y1 == y2) {
+        fill_hspan(view, y1, x1, x2, r, g, b);
+        return;
+    }
+    if (x1 == x2) {
+        fill_vspan(view, x1, first, last, r, g, b);
+        return;
+    }
+
+    long long dx = llabs((long long)x2 - x1), dy = llabs((long long)y2 - y1);
     int sx = (x1 < x2) ? 1 : -1, sy = (y1 < y2) ? 1 : -1;
-    int err = (dx > dy ? dx : -dy) / 2, e2;
+    long long err0 = (dx > dy ? dx : -dy) / 2;
 
-    while (1) {
-        if (x1 >= 0 && x1 < width && y1 >= 0 && y1 < height) {
-            int bmp_y = height - 1 - y1;
-            int idx = (bmp_y * width + x1) * 3;
-            pixel_data[idx] = b;
-            pixel_data[idx + 1] = g;
-            pixel_data[idx + 2] = r;
+    /* сколько шагов по y нужно от y1 до первой строки полосы */
+    long long t = sy > 0 ? first - y1 : y1 - last;
+    long long k, x_steps, y_steps;
+    if (dx > dy) {
+        k = t == 0 ? 0 : ((t - 1) * dx + err0) / dy + 1;
+        x_steps = k;
+        y_steps = (k * dy - err0 + dx - 1) / dx;
+    } else {
+        k = t;
+        x_steps = (err0 + k * dx + dy - 1) / dy;
+        y_steps = k;
+    }
+    long long err = err0 + y_steps * dx - x_steps * dy;
+    int x = x1 + sx * (int)x_steps;
+    int y = y1 + sy * (int)y_steps;
+    long long e2;
+
+    /* адрес пикселя сдвигается вместе с x и y */
+    ptrdiff_t offset = pixel_offset(view, x, y);
+    ptrdiff_t step_x = sx * view->bpp, step_y = sy * view->stride;
+    while (y >= first && y <= last) {
+        if (x >= 0 && x < view->width) {
+            put_pixel(view->data + offset, r, g, b);
         }
-        if (x1 == x2 && y1 == y2) break;
+        if (x == x2 && y == y2) break;
         e2 = err;
-        if (e2 > -dx) { err -= dy; x1 += sx; }
-        if (e2 < dy)  { err += dx; y1 += sy; }
+        if (e2 > -dx) { err -= dy; x += sx; offset += step_x; }
+        if (e2 < dy)  { err += dx; y += sy; offset += step_y; }
     }
 }
 
-int get_row_size(int width) {
-    return ((width * 3 + 3) / 4) * 4;
+void draw_line(const ImageView* view, int x1, int y1, int x2, int y2, unsigned char r, unsigned char g, unsigned char b) {
+    draw_line_rows(view, x1, y1, x2, y2, r, g, b, 0, view->height - 1);
 }
 
-int main(int argc, char* argv[]) {
-    FILE* file = fopen(argv[1], "rb+");
+typedef struct {
+    int x1, y1, x2, y2;
+    unsigned char r, g, b;
+} Segment;
+
+typedef struct {
+    Segment* items;
+    size_t count;
+    size_t capacity;
+} SegmentList;
+
+int push_segment(SegmentList* list, Segment segment) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        Segment* items = realloc(list->items, capacity * sizeof(Segment));
+        if (items == NULL) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = segment;
+    return 0;
+}
+
+/* строка команд: x1 y1 x2 y2 r g b; пустые строки и строки с # пропускаются */
+int read_segments(FILE* input, SegmentList* list) {
+    char line[256];
+    int number = 0;
+    while (fgets(line, sizeof(line), input) != NULL) {
+        ++number;
+        char* text = line + strspn(line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\0') {
+            continue;
+        }
+        int x1, y1, x2, y2, r, g, b;
+        if (sscanf(text, "%d %d %d %d %d %d %d", &x1, &y1, &x2, &y2, &r, &g, &b) != 7) {
+            fprintf(stderr, "строка %d: нужно x1 y1 x2 y2 r g b\n", number);
+            return -1;
+        }
+        Segment segment = {x1, y1, x2, y2, (unsigned char)r, (unsigned char)g, (unsigned char)b};
+        if (push_segment(list, segment) != 0) {
+            fprintf(stderr, "не хватает памяти\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* полосы по band_rows строк раздаются потокам по очереди; полосу рисует один поток,
+   поэтому блокировки не нужны, а в пределах полосы порядок отрезков тот же, что без потоков */
+enum { band_rows = 64 };
+
+/* отрезки, разложенные по полосам: полоса b - строки изображения b * band_rows ..
+   (b + 1) * band_rows - 1, её отрезки - номера order[start[b]] .. order[start[b + 1] - 1]
+   в порядке файла команд. Это устойчивая сортировка по строкам: полоса перебирает только
+   задевающие её отрезки, а в местах пересечения остаётся цвет отрезка, записанного позже */
+typedef struct {
+    int bands;
+    size_t* start;
+    size_t* order;
+} BandIndex;
+
+/* строки отрезка внутри изображения; 0, если он целиком выше или ниже */
+int segment_rows(const Segment* s, int height, int* top, int* bottom) {
+    *top = s->y1 < s->y2 ? s->y1 : s->y2;
+    *bottom = s->y1 < s->y2 ? s->y2 : s->y1;
+    if (*top < 0) *top = 0;
+    if (*bottom >= height) *bottom = height - 1;
+    return *top <= *bottom;
+}
+
+void free_band_index(BandIndex* index) {
+    free(index->start);
+    free(index->order);
+}
+
+/* два прохода: сколько отрезков в каждой полосе, потом раскладка по местам */
+int build_band_index(BandIndex* index, const SegmentList* list, int height) {
+    index->bands = (height + band_rows - 1) / band_rows;
+    index->start = calloc((size_t)index->bands + 1, sizeof(size_t));
+    index->order = NULL;
+    size_t* cursor = malloc(((size_t)index->bands + 1) * sizeof(size_t));
+    if (index->start == NULL || cursor == NULL) {
+        free(cursor);
+        free_band_index(index);
+        return -1;
+    }
+    int top, bottom;
+    for (size_t i = 0; i < list->count; ++i) {
+        if (segment_rows(&list->items[i], height, &top, &bottom)) {
+            for (int b = top / band_rows; b <= bottom / band_rows; ++b) {
+                ++index->start[b + 1];
+            }
+        }
+    }
+    for (int b = 0; b < index->bands; ++b) {
+        index->start[b + 1] += index->start[b];
+    }
+    index->order = malloc((index->start[index->bands] + 1) * sizeof(size_t));
+    if (index->order == NULL) {
+        free(cursor);
+        free_band_index(index);
+        return -1;
+    }
+    memcpy(cursor, index->start, ((size_t)index->bands + 1) * sizeof(size_t));
+    for (size_t i = 0; i < list->count; ++i) {
+        if (segment_rows(&list->items[i], height, &top, &bottom)) {
+            for (int b = top / band_rows; b <= bottom / band_rows; ++b) {
+                index->order[cursor[b]++] = i;
+            }
+        }
+    }
+    free(cursor);
+    return 0;
+}
+
+typedef struct {
+    ImageView view;
+    int top; /* какой строке изображения соответствует строка 0 окна */
+    const SegmentList* list;
+    const BandIndex* index;
+    int first_band; /* полосы индекса, которые задевает окно */
+    int last_band;
+    atomic_int next_band;
+} BandJob;
+
+void* draw_bands(void* arg) {
+    BandJob* job = arg;
+    int first_row = job->top;
+    int last_row = job->top + job->view.height - 1;
+    int k;
+    while ((k = atomic_fetch_add(&job->next_band, 1)) <= job->last_band - job->first_band) {
+        /* полосы идут в порядке памяти: при строках снизу вверх первой берётся нижняя */
+        int band = job->view.stride < 0 ? job->last_band - k : job->first_band + k;
+        int first = band * band_rows;
+        int last = first + band_rows - 1;
+        if (first < first_row) first = first_row;
+        if (last > last_row) last = last_row;
+        for (size_t j = job->index->start[band]; j < job->index->start[band + 1]; ++j) {
+            const Segment* s = &job->list->items[job->index->order[j]];
+            draw_line_rows(&job->view, s->x1, s->y1 - job->top, s->x2, s->y2 - job->top, s->r, s->g, s->b,
+                           first - job->top, last - job->top);
+        }
+    }
+    return NULL;
+}
+
+/* рисует отрезки в окно, строка 0 которого - строка top изображения; index построен
+   по всему изображению. Один поток идёт по полосам сам */
+void draw_segments_at(const ImageView* view, int top, const SegmentList* list, const BandIndex* index, int threads) {
+    BandJob job = {*view, top, list, index, top / band_rows, (top + view->height - 1) / band_rows, 0};
+    pthread_t* workers = threads > 1 ? malloc(threads * sizeof(pthread_t)) : NULL;
+    int started = 0;
+    while (workers != NULL && started < threads - 1 &&
+           pthread_create(&workers[started], NULL, draw_bands, &job) == 0) {
+        ++started;
+    }
+    draw_bands(&job);
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+}
+
+int draw_segments(const ImageView* view, const SegmentList* list, int threads) {
+    BandIndex index;
+    if (build_band_index(&index, list, view->height) != 0) {
+        fprintf(stderr, "не хватает памяти\n");
+        return -1;
+    }
+    draw_segments_at(view, 0, list, &index, threads);
+    free_band_index(&index);
+    return 0;
+}
+
+/* без --batch рисуются две диагонали; пустой файл команд ничего не рисует */
+void default_segments(SegmentList* list, int w, int h) {
+    Segment first = {0, 0, w - 1, h - 1, 255, 0, 0};
+    Segment second = {0, h - 1, w - 1, 0, 255, 0, 0};
+    push_segment(list, first);
+    push_segment(list, second);
+}
+
+/* файл отображается в память целиком: draw_line пишет прямо в строки пикселей,
+   а на диск уходят только изменённые страницы */
+typedef struct {
+    unsigned char* base;
+    size_t size;
+    ImageView view;
+} MappedBMP;
+
+/* 24 бита на пиксель без сжатия (BI_RGB = 0), байты строки считаются в int
+   и массив пикселей целиком в файле */
+int check_bmp(const char* path, const BMPHeader* header, const BMPInfoHeader* infoheader, size_t file_size) {
+    int width = infoheader->biWidth;
+    int height = infoheader->biHeight;
+    if (infoheader->biBitCount != 24 || infoheader->biCompression != 0 ||
+        width <= 0 || width > (INT_MAX - 3) / 3 || height == 0 || height == INT_MIN ||
+        header->bfOffBits < 0 ||
+        (size_t)header->bfOffBits + get_row_size(width) * (size_t)abs(height) > file_size) {
+        fprintf(stderr, "%s: нужен 24-битный BMP\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int map_bmp(const char* path, MappedBMP* bmp) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BMPHeader) + sizeof(BMPInfoHeader)) {
+        fprintf(stderr, "%s: не BMP\n", path);
+        close(fd);
+        return -1;
+    }
+    bmp->size = st.st_size;
+    bmp->base = mmap(NULL, bmp->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bmp->base == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
     BMPHeader header;
     BMPInfoHeader infoheader;
-    fread(&header, sizeof(header), 1, file);
-    fread(&infoheader, sizeof(infoheader), 1, file);
+    memcpy(&header, bmp->base, sizeof(header));
+    memcpy(&infoheader, bmp->base + sizeof(header), sizeof(infoheader));
+    if (check_bmp(path, &header, &infoheader, bmp->size) != 0) {
+        munmap(bmp->base, bmp->size);
+        return -1;
+    }
+    bmp->view = bmp_view(bmp->base + header.bfOffBits, infoheader.biWidth, infoheader.biHeight);
+    /* линии задевают редкие страницы, упреждающее чтение всего файла не нужно */
+    madvise(bmp->base, bmp->size, MADV_RANDOM);
+    return 0;
+}
+
+int unmap_bmp(MappedBMP* bmp) {
+    int status = msync(bmp->base, bmp->size, MS_SYNC);
+    if (status != 0) {
+        perror("msync");
+    }
+    munmap(bmp->base, bmp->size);
+    return status;
+}
+
+/* прежний путь: весь массив пикселей читается в память и записывается обратно */
+int edit_copy(const char* path, SegmentList* list, int defaults, int threads) {
+    FILE* file = fopen(path, "rb+");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    BMPHeader header;
+    BMPInfoHeader infoheader;
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 ||
+        fread(&header, sizeof(header), 1, file) != 1 ||
+        fread(&infoheader, sizeof(infoheader), 1, file) != 1) {
+        fprintf(stderr, "%s: не BMP\n", path);
+        fclose(file);
+        return 1;
+    }
+    if (check_bmp(path, &header, &infoheader, st.st_size) != 0) {
+        fclose(file);
+        return 1;
+    }
 
     int w = infoheader.biWidth;
-    int h = infoheader.biHeight;
-    int row_size = get_row_size(w);
-    char* data = malloc(row_size * h);
-    fseek(file, header.bfOffBits, SEEK_SET);
-    fread(data, 1, row_size * h, file);
+    int h = abs(infoheader.biHeight);
+    size_t bytes = get_row_size(w) * h;
+    unsigned char* data = malloc(bytes);
+    if (data == NULL) {
+        fprintf(stderr, "не хватает памяти\n");
+        fclose(file);
+        return 1;
+    }
+    if (fseek(file, header.bfOffBits, SEEK_SET) != 0 || fread(data, 1, bytes, file) != bytes) {
+        perror(path);
+        free(data);
+        fclose(file);
+        return 1;
+    }
 
-    draw_line(data, w, h, 0, 0, w - 1, h - 1, 255, 0, 0);
-    draw_line(data, w, h, 0, h - 1, w - 1, 0, 255, 0, 0);
+    ImageView view = bmp_view(data, w, infoheader.biHeight);
+    if (defaults) {
+        default_segments(list, w, h);
+    }
+    if (draw_segments(&view, list, threads) != 0) {
+        free(data);
+        fclose(file);
+        return 1;
+    }
 
-    fseek(file, header.bfOffBits, SEEK_SET);
-    fwrite(data, 1, row_size * h, file);
+    int status = 0;
+    if (fseek(file, header.bfOffBits, SEEK_SET) != 0 || fwrite(data, 1, bytes, file) != bytes) {
+        perror(path);
+        status = 1;
+    }
 
     free(data);
-    fclose(file);
-    return 0;
-}
\ No newline at end of file
+    if (fclose(file) != 0) {
+        perror(path);
+        status = 1;
+    }
+    return status;
+}
+
+int edit_mapped(const char* path, SegmentList* list, int defaults, int threads) {
+    MappedBMP bmp;
+    if (map_bmp(path, &bmp) != 0) {
+        return 1;
+    }
+    if (defaults) {
+        default_segments(list, bmp.view.width, bmp.view.height);
+    }
+    int status = draw_segments(&bmp.view, list, threads) == 0 ? 0 : 1;
+    if (unmap_bmp(&bmp) != 0) {
+        status = 1;
+    }
+    return status;
+}
+
+/* файл обрабатывается полосами по stream_rows строк в порядке хранения: полоса читается,
+   в неё рисуются задевающие её отрезки, и она записывается обратно. Памяти нужно на одну
+   полосу, полосы без отрезков не читаются вовсе */
+int edit_stream(const char* path, SegmentList* list, int defaults, int threads, int stream_rows) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    BMPHeader header;
+    BMPInfoHeader infoheader;
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        pread(fd, &infoheader, sizeof(infoheader), sizeof(header)) != (ssize_t)sizeof(infoheader)) {
+        fprintf(stderr, "%s: не BMP\n", path);
+        close(fd);
+        return 1;
+    }
+    if (check_bmp(path, &header, &infoheader, st.st_size) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    int w = infoheader.biWidth;
+    int h = abs(infoheader.biHeight);
+    int bottom_up = infoheader.biHeight > 0;
+    size_t row_size = get_row_size(w);
+    if (stream_rows <= 0) {
+        stream_rows = (int)((16u << 20) / row_size);
+        if (stream_rows == 0) stream_rows = 1;
+    }
+    if (stream_rows > h) stream_rows = h;
+    unsigned char* band = malloc(row_size * stream_rows);
+    if (band == NULL) {
+        fprintf(stderr, "не хватает памяти\n");
+        close(fd);
+        return 1;
+    }
+
+    if (defaults) {
+        default_segments(list, w, h);
+    }
+    BandIndex index;
+    if (build_band_index(&index, list, h) != 0) {
+        fprintf(stderr, "не хватает памяти\n");
+        free(band);
+        close(fd);
+        return 1;
+    }
+
+    int status = 0;
+    for (int start = 0; start < h && status == 0; start += stream_rows) {
+        int rows = h - start < stream_rows ? h - start : stream_rows;
+        /* строки start.. файла - это строки first..last изображения */
+        int first = bottom_up ? h - start - rows : start;
+        int last = first + rows - 1;
+        /* задевают полосу только отрезки из полос индекса, на которые она ложится */
+        int touched = 0;
+        for (int b = first / band_rows; b <= last / band_rows && !touched; ++b) {
+            for (size_t j = index.start[b]; j < index.start[b + 1] && !touched; ++j) {
+                int top, bottom;
+                segment_rows(&list->items[index.order[j]], h, &top, &bottom);
+                touched = top <= last && bottom >= first;
+            }
+        }
+        if (!touched) {
+            continue;
+        }
+
+        off_t offset = header.bfOffBits + (off_t)row_size * start;
+        size_t bytes = row_size * rows;
+        if (pread(fd, band, bytes, offset) != (ssize_t)bytes) {
+            perror("pread");
+            status = 1;
+            break;
+        }
+        ImageView view = bmp_view(band, w, bottom_up ? rows : -rows);
+        draw_segments_at(&view, first, list, &index, threads);
+        if (pwrite(fd, band, bytes, offset) != (ssize_t)bytes) {
+            perror("pwrite");
+            status = 1;
+        }
+    }
+
+    free_band_index(&index);
+    free(band);
+    if (close(fd) != 0) {
+        perror(path);
+        status = 1;
+    }
+    return status;
+}
+
+/* ./2 файл.bmp [--copy | --stream [--band-rows N]] [--batch команды.txt] [--threads N];
+   вместо файла команд "-" - стандартный ввод. По умолчанию потоков столько, сколько ядер,
+   а полоса при --stream - около 16 МБ */
+int main(int argc, char* argv[]) {
+    const char* path = NULL;
+    const char* commands = NULL;
+    int copy = 0;
+    int stream = 0;
+    int stream_rows = 0;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--copy") == 0) {
+            copy = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--band-rows") == 0 && i + 1 < argc) {
+            stream_rows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            commands = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "использование: %s файл.bmp [--copy | --stream [--band-rows N]] [--batch команды.txt|-] [--threads N]\n", argv[0]);
+        return 1;
+    }
+
+    SegmentList list = {NULL, 0, 0};
+    if (commands != NULL) {
+        FILE* input = strcmp(commands, "-") == 0 ? stdin : fopen(commands, "r");
+        if (input == NULL) {
+            perror(commands);
+            return 1;
+        }
+        int status = read_segments(input, &list);
+        if (input != stdin) {
+            fclose(input);
+        }
+        if (status != 0) {
+            free(list.items);
+            return 1;
+        }
+    }
+
+    int status;
+    if (stream) {
+        status = edit_stream(path, &list, commands == NULL, threads, stream_rows);
+    } else if (copy) {
+        status = edit_copy(path, &list, commands == NULL, threads);
+    } else {
+        status = edit_mapped(path, &list, commands == NULL, threads);
+    }
+    free(list.items);
+    return status;
+}
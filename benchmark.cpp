@@ -0,0 +1,388 @@
+// Сравнение всех множеств из заданий с std::set.
+// Сборка: g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark   (можно добавить -mavx2)
+// Запуск: ./benchmark [n] [потоки через запятую]
+//
+// Каждый набор замеров идёт в отдельном процессе (fork), чтобы пиковый RSS
+// считался только для него и не зависел от памяти, оставшейся от прошлых замеров.
+// Печатается: млн операций в секунду, p50/p99 задержки одной операции и пиковый RSS.
+// У обхода задержки нет ("-"): шаг итератора короче разрешения часов.
+
+// Все заголовки подключаются заранее: ниже задания включаются внутрь namespace,
+// и их собственные #include должны ничего не делать
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <iterator>
+#include <string>
+#include <optional>
+#include <tuple>
+#include <string_view>
+#include <stdexcept>
+#include <chrono>
+#include <random>
+#include <set>
+#include <cstring>
+#include <fstream>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Каждое задание - в своём namespace, их main переименованы
+#define main task_main
+namespace shared_set {
+#include "task2.cpp"
+}
+namespace mutex_set {
+#include "task2,1.cpp"
+}
+namespace plain_set {
+#include "task22.cpp"
+}
+namespace wrapped_set {
+#include "task2,3.cpp"
+}
+#undef main
+
+using bench_clock = std::chrono::steady_clock;
+
+// Задержка замеряется у каждой sample_every-й операции, чтобы сам замер не съедал пропускную способность
+constexpr int sample_every = 8;
+
+// Результат одной строки таблицы
+struct result {
+    char impl[32];
+    char workload[16];
+    char op[16];
+    int threads;
+    double mops;
+    double p50_ns;
+    double p99_ns;
+};
+
+// std::set в том же интерфейсе (contains появился только в C++20)
+template <typename T>
+class std_set {
+private:
+    std::set<T> s;
+
+public:
+    void insert(const T& value) { s.insert(value); }
+    void erase(const T& value) { s.erase(value); }
+    bool contains(const T& value) const { return s.count(value) != 0; }
+    typename std::set<T>::const_iterator begin() const { return s.begin(); }
+    typename std::set<T>::const_iterator end() const { return s.end(); }
+};
+
+// std::set под shared_mutex - базовая линия для многопоточных замеров
+template <typename T>
+class locked_std_set {
+private:
+    std::set<T> s;
+    mutable std::shared_mutex mtx;
+
+public:
+    void insert(const T& value) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        s.insert(value);
+    }
+
+    void erase(const T& value) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        s.erase(value);
+    }
+
+    bool contains(const T& value) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return s.count(value) != 0;
+    }
+};
+
+// Ключи по распределению Ципфа (s = 0.99): редкие ключи "горячие".
+// Номер по популярности переводится в ключ через случайную перестановку
+std::vector<int> zipf_keys(size_t count, int universe, std::mt19937& gen) {
+    std::vector<double> cdf(universe);
+    double sum = 0;
+    for (int i = 0; i < universe; ++i) {
+        sum += 1.0 / std::pow(i + 1.0, 0.99);
+        cdf[i] = sum;
+    }
+    std::vector<int> perm(universe);
+    for (int i = 0; i < universe; ++i) perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), gen);
+
+    std::uniform_real_distribution<double> dist(0, sum);
+    std::vector<int> keys(count);
+    for (int& key : keys) {
+        key = perm[std::lower_bound(cdf.begin(), cdf.end(), dist(gen)) - cdf.begin()];
+    }
+    return keys;
+}
+
+std::vector<int> make_keys(const std::string& workload, size_t n, std::mt19937& gen) {
+    std::vector<int> keys(n);
+    if (workload == "seq") {
+        for (size_t i = 0; i < n; ++i) keys[i] = static_cast<int>(i);
+    } else if (workload == "random") {
+        std::uniform_int_distribution<int> dist(0, static_cast<int>(n) * 4);
+        for (int& key : keys) key = dist(gen);
+    } else {
+        keys = zipf_keys(n, static_cast<int>(n), gen);
+    }
+    return keys;
+}
+
+// p-й процентиль выборки задержек; -1, если замеров нет (в таблице печатается "-")
+double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return -1;
+    size_t k = static_cast<size_t>(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+result make_result(const char* impl, const std::string& workload, const char* op, int threads,
+                   size_t ops, double seconds, std::vector<double>& samples) {
+    result r{};
+    std::snprintf(r.impl, sizeof(r.impl), "%s", impl);
+    std::snprintf(r.workload, sizeof(r.workload), "%s", workload.c_str());
+    std::snprintf(r.op, sizeof(r.op), "%s", op);
+    r.threads = threads;
+    r.mops = seconds > 0 ? ops / seconds / 1e6 : 0;
+    r.p50_ns = percentile(samples, 0.50);
+    r.p99_ns = percentile(samples, 0.99);
+    return r;
+}
+
+// Прогоняет f по всем ключам, замеряя общее время и задержку выборочных операций
+template <typename F>
+result time_ops(const char* impl, const std::string& workload, const char* op,
+                const std::vector<int>& keys, F f) {
+    std::vector<double> samples;
+    samples.reserve(keys.size() / sample_every + 1);
+    auto start = bench_clock::now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % sample_every == 0) {
+            auto t0 = bench_clock::now();
+            f(keys[i]);
+            samples.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count());
+        } else {
+            f(keys[i]);
+        }
+    }
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    return make_result(impl, workload, op, 1, keys.size(), seconds, samples);
+}
+
+// Полный обход по порядку
+template <typename S>
+size_t iterate(const S& s) {
+    size_t visited = 0;
+    for (auto it = s.begin(); it != s.end(); ++it) {
+        visited += (*it & 1) + 1;
+    }
+    return visited;
+}
+
+std::atomic<size_t> sink{0}; // Не даёт компилятору выбросить результаты чтений
+
+// Однопоточный набор: вставка, поиск, обход, удаление
+template <typename S>
+std::vector<result> run_single(const char* impl, const std::string& workload, size_t n) {
+    std::mt19937 gen(42);
+    std::vector<int> keys = make_keys(workload, n, gen);
+    std::vector<int> probes = make_keys(workload, n, gen);
+    std::vector<result> rows;
+    S s;
+
+    rows.push_back(time_ops(impl, workload, "insert", keys, [&](int k) { s.insert(k); }));
+
+    size_t found = 0;
+    rows.push_back(time_ops(impl, workload, "contains", probes, [&](int k) { found += s.contains(k); }));
+    sink += found;
+
+    {
+        std::vector<double> samples; // Шаг обхода слишком короток для замера часами - задержки не печатаются
+        auto start = bench_clock::now();
+        size_t visited = iterate(s);
+        double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+        sink += visited;
+        rows.push_back(make_result(impl, workload, "iterate", 1, visited, seconds, samples));
+    }
+
+    rows.push_back(time_ops(impl, workload, "erase", keys, [&](int k) { s.erase(k); }));
+    return rows;
+}
+
+// Смешанная нагрузка: threads потоков, доля чтений read_share, остальное - вставки и удаления
+template <typename S>
+std::vector<result> run_mixed(const char* impl, size_t n, int threads, double read_share) {
+    S s;
+    for (size_t i = 0; i < n; i += 2) s.insert(static_cast<int>(i)); // Заполнен наполовину
+
+    size_t ops_per_thread = n;
+    std::vector<std::vector<double>> samples(threads);
+    std::vector<std::thread> workers;
+    auto start = bench_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937 gen(1000 + t);
+            std::uniform_int_distribution<int> key(0, static_cast<int>(n) - 1);
+            std::uniform_real_distribution<double> coin(0, 1);
+            size_t found = 0;
+            for (size_t i = 0; i < ops_per_thread; ++i) {
+                int k = key(gen);
+                double c = coin(gen);
+                bool sampled = i % sample_every == 0;
+                bench_clock::time_point t0;
+                if (sampled) t0 = bench_clock::now();
+                if (c < read_share) {
+                    found += s.contains(k);
+                } else if (c < read_share + (1 - read_share) / 2) {
+                    s.insert(k);
+                } else {
+                    s.erase(k);
+                }
+                if (sampled) {
+                    samples[t].push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count());
+                }
+            }
+            sink += found;
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (auto& part : samples) all.insert(all.end(), part.begin(), part.end());
+    char op[16];
+    std::snprintf(op, sizeof(op), "mix %d%%r", static_cast<int>(read_share * 100 + 0.5));
+    return {make_result(impl, "random", op, threads, ops_per_thread * threads, seconds, all)};
+}
+
+// ShardedSet требует границ в конструкторе
+class sharded_int_set : public mutex_set::ShardedSet<int> {
+public:
+    static size_t universe;
+
+    sharded_int_set()
+        : mutex_set::ShardedSet<int>(mutex_set::ShardedSet<int>::even_bounds(0, static_cast<int>(universe), 16)) {}
+};
+
+size_t sharded_int_set::universe = 0;
+
+// Запускает замер в дочернем процессе; результаты приходят через pipe, пиковый RSS - из wait4
+template <typename F>
+void run_isolated(F bench) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        return;
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        std::vector<result> rows = bench();
+        ssize_t written = write(fds[1], rows.data(), rows.size() * sizeof(result));
+        (void)written;
+        close(fds[1]);
+        _exit(0);
+    }
+    close(fds[1]);
+    std::vector<result> rows;
+    result r;
+    while (read(fds[0], &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r))) {
+        rows.push_back(r);
+    }
+    close(fds[0]);
+
+    int status = 0;
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+    double rss_mb = usage.ru_maxrss / 1024.0; // ru_maxrss в Linux - в килобайтах
+
+    for (const result& row : rows) {
+        std::cout << std::left << std::setw(22) << row.impl << std::setw(8) << row.workload
+                  << std::setw(11) << row.op << std::right << std::setw(4) << row.threads
+                  << std::fixed << std::setprecision(2) << std::setw(10) << row.mops
+                  << std::setprecision(0);
+        if (row.p50_ns < 0) {
+            std::cout << std::setw(10) << "-" << std::setw(10) << "-";
+        } else {
+            std::cout << std::setw(10) << row.p50_ns << std::setw(10) << row.p99_ns;
+        }
+        std::cout << std::setprecision(1) << std::setw(10) << rss_mb << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    std::vector<int> thread_counts;
+    if (argc > 2) {
+        std::string list = argv[2];
+        size_t pos = 0;
+        while (pos < list.size()) {
+            thread_counts.push_back(std::atoi(list.c_str() + pos));
+            pos = list.find(',', pos);
+            if (pos == std::string::npos) break;
+            ++pos;
+        }
+    } else {
+        thread_counts = {1, 2, 4, 8, 16, 32, 64};
+    }
+    sharded_int_set::universe = n;
+
+    std::cout << std::left << std::setw(22) << "impl" << std::setw(8) << "keys" << std::setw(11) << "op"
+              << std::right << std::setw(4) << "thr" << std::setw(10) << "Mops/s" << std::setw(10) << "p50 ns"
+              << std::setw(10) << "p99 ns" << std::setw(10) << "RSS MB" << std::endl;
+
+    for (const std::string workload : {"seq", "random", "zipf"}) {
+        run_isolated([&] { return run_single<std_set<int>>("std::set", workload, n); });
+        run_isolated([&] { return run_single<shared_set::Set<int>>("Set shared_mutex", workload, n); });
+        run_isolated([&] {
+            return run_single<shared_set::ConcurrentSet<int>>("ConcurrentSet skip", workload, n);
+        });
+        run_isolated([&] { return run_single<mutex_set::Set<int>>("Set mutex", workload, n); });
+        run_isolated([&] { return run_single<plain_set::Set<int>>("Set plain", workload, n); });
+        run_isolated([&] { return run_single<wrapped_set::my_set<int>>("my_set rb", workload, n); });
+        run_isolated([&] {
+            return run_single<wrapped_set::my_set<int, wrapped_set::btree<int>>>("my_set btree", workload, n);
+        });
+        run_isolated([&] {
+            return run_single<wrapped_set::my_set<int, wrapped_set::compact_tree<int>>>("my_set compact", workload, n);
+        });
+    }
+
+    for (double read_share : {0.5, 0.9, 0.99}) {
+        for (int threads : thread_counts) {
+            run_isolated([&] { return run_mixed<locked_std_set<int>>("std::set shared_mutex", n, threads, read_share); });
+            run_isolated([&] { return run_mixed<shared_set::Set<int>>("Set shared_mutex", n, threads, read_share); });
+            run_isolated([&] {
+                return run_mixed<shared_set::ConcurrentSet<int>>("ConcurrentSet skip", n, threads, read_share);
+            });
+            run_isolated([&] { return run_mixed<mutex_set::Set<int>>("Set mutex", n, threads, read_share); });
+            run_isolated([&] { return run_mixed<sharded_int_set>("ShardedSet x16", n, threads, read_share); });
+        }
+    }
+    return 0;
+}
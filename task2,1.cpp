@@ -2,6 +2,9 @@
 #include <mutex>       
 #include <thread>      
 #include <cstddef> 
+#include <vector>
+#include <algorithm>
+#include <memory>
 
 //тип Т
 template <typename T>
@@ -384,6 +387,130 @@ public:
     }
 };
 
+//N независимых деревьев со своими мьютексами, ключи разбиты по диапазонам:
+//шард i хранит ключи из [bounds[i-1], bounds[i]), поэтому обход шардов подряд упорядочен
+template <typename T>
+class ShardedSet {
+private:
+    //каждый шард на своей кэш-линии, чтобы мьютексы соседей не делили линию
+    struct alignas(64) Shard {
+        Set<T> set;
+    };
+
+    std::vector<T> bounds;            //границы диапазонов, по возрастанию
+    std::size_t count;                //число шардов = bounds.size() + 1
+    std::unique_ptr<Shard[]> shards;
+
+    Set<T>& shard_for(const T& value) const {
+        std::size_t i = std::upper_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+        return shards[i].set;
+    }
+
+public:
+    //итератор по всем шардам по очереди
+    class Iterator {
+    private:
+        const ShardedSet* owner;
+        std::size_t shard;
+        typename Set<T>::Iterator it;
+
+        //пропуск пустых шардов
+        void skip_empty() {
+            while (shard < owner->count && it == owner->shards[shard].set.end()) {
+                ++shard;
+                if (shard < owner->count) {
+                    it = owner->shards[shard].set.begin();
+                }
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        Iterator(const ShardedSet* o, std::size_t s, typename Set<T>::Iterator i)
+            : owner(o), shard(s), it(i) {
+            skip_empty();
+        }
+
+        reference operator*() const {
+            return *it;
+        }
+
+        pointer operator->() const {
+            return &*it;
+        }
+
+        Iterator& operator++() {
+            ++it;
+            skip_empty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return shard == other.shard && it == other.it;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+    };
+
+    explicit ShardedSet(std::vector<T> split_points)
+        : bounds(std::move(split_points)), count(bounds.size() + 1), shards(new Shard[count]) {
+        std::sort(bounds.begin(), bounds.end());
+    }
+
+    //равномерные границы для чисел из [lo, hi)
+    static std::vector<T> even_bounds(T lo, T hi, std::size_t shard_count) {
+        std::vector<T> result;
+        for (std::size_t i = 1; i < shard_count; ++i) {
+            result.push_back(static_cast<T>(lo + (hi - lo) * static_cast<double>(i) / shard_count));
+        }
+        return result;
+    }
+
+    void insert(const T& value) {
+        shard_for(value).insert(value);
+    }
+
+    void erase(const T& value) {
+        shard_for(value).erase(value);
+    }
+
+    bool contains(const T& value) const {
+        return shard_for(value).contains(value);
+    }
+
+    bool empty() const {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!shards[i].set.empty()) return false;
+        }
+        return true;
+    }
+
+    std::size_t shard_count() const {
+        return count;
+    }
+
+    Iterator begin() const {
+        return Iterator(this, 0, shards[0].set.begin());
+    }
+
+    Iterator end() const {
+        return Iterator(this, count, shards[count - 1].set.end());
+    }
+};
+
 int main() {
     Set<int> s;
     
@@ -440,5 +567,28 @@ int main() {
     writer.join();
     reader.join();
 
+    //несколько писателей в разные шарды не ждут друг друга: писатель t пишет
+    //только в свой диапазон [100t, 100t + 100), то есть в свой шард
+    ShardedSet<int> sharded(ShardedSet<int>::even_bounds(0, 400, 4));
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&sharded, t]{
+            for (int i = 100 * t; i < 100 * t + 100; ++i) {
+                sharded.insert(i);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+
+    int in_order = 0;
+    int prev = -1;
+    for (int value : sharded) {
+        if (value > prev) ++in_order;
+        prev = value;
+    }
+    std::cout << "Шардов: " << sharded.shard_count() << ", по порядку: " << in_order << std::endl;
+
     return 0;
 }
\ No newline at end of file
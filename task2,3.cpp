@@ -1,4 +1,14 @@
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <iterator>
+#include <utility>
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 // Класс узла дерева
 template <typename T>
@@ -9,10 +19,11 @@ public:
     node* right;         // Указатель на правого потомка
     node* parent;        // Указатель на родителя
     bool is_red;         // Цвет узла: true - красный, false - чёрный
+    size_t count;        // Количество узлов в поддереве (включая сам узел)
 
     // Конструктор узла
     node(const T& value, node* p = nullptr, node* l = nullptr, node* r = nullptr, bool red = true)
-        : data(value), parent(p), left(l), right(r), is_red(red) {}
+        : data(value), parent(p), left(l), right(r), is_red(red), count(1) {}
 };
 
 // Внутреннее дерево (красно-чёрное)
@@ -21,6 +32,16 @@ class tree {
 private:
     node<T>* root = nullptr; // Корень дерева
 
+    // Размер поддерева (0 для пустого)
+    static size_t subtree_size(node<T>* n) {
+        return n ? n->count : 0;
+    }
+
+    // Пересчитывает размер поддерева по потомкам
+    static void update_count(node<T>* n) {
+        n->count = 1 + subtree_size(n->left) + subtree_size(n->right);
+    }
+
     // Левый поворот узла x
     void left_rotate(node<T>* x) {
         node<T>* y = x->right; // y - правый потомок x
@@ -32,6 +53,8 @@ private:
         else x->parent->right = y;
         y->left = x;          // x становится левым потомком y
         x->parent = y;        // y становится родителем x
+        y->count = x->count;  // y теперь корень того же поддерева
+        update_count(x);      // x потерял правое поддерево y
     }
 
     // Правый поворот узла x
@@ -45,10 +68,13 @@ private:
         else x->parent->left = y;
         y->right = x;         // x становится правым потомком y
         x->parent = y;        // y становится родителем x
+        y->count = x->count;  // y теперь корень того же поддерева
+        update_count(x);      // x потерял левое поддерево y
     }
 
     // Восстановление свойств красно-чёрного дерева после вставки
-    void insert_fixup(node<T>* z) {
+    // Возвращает true, если красный корень перекрашен в чёрный (чёрная высота выросла на 1)
+    bool insert_fixup(node<T>* z) {
         // Цикл продолжается, пока родитель z красный (нарушение правила)
         while (z != root && z->parent->is_red) {
             if (z->parent == z->parent->parent->left) { // Если родитель z - левый потомок дедушки
@@ -85,21 +111,61 @@ private:
                 }
             }
         }
+        bool grew = root->is_red;
         root->is_red = false; // Корень всегда чёрный
+        return grew;
     }
 
     // Находит узел с минимальным значением в поддереве
-    node<T>* minimum(node<T>* x) {
+    static node<T>* minimum(node<T>* x) {
         while (x && x->left) x = x->left; // Идём по левой ветви до конца
         return x;
     }
 
     // Находит узел с максимальным значением в поддереве
-    node<T>* maximum(node<T>* x) {
+    static node<T>* maximum(node<T>* x) {
         while (x && x->right) x = x->right; // Идём по правой ветви до конца
         return x;
     }
 
+    // Следующий по порядку узел (nullptr после максимального)
+    static node<T>* successor(node<T>* x) {
+        if (x->right) return minimum(x->right);
+        node<T>* p = x->parent;
+        while (p && x == p->right) { // Поднимаемся, пока приходим справа
+            x = p;
+            p = p->parent;
+        }
+        return p;
+    }
+
+    // Предыдущий по порядку узел (nullptr перед минимальным)
+    static node<T>* predecessor(node<T>* x) {
+        if (x->left) return maximum(x->left);
+        node<T>* p = x->parent;
+        while (p && x == p->left) {
+            x = p;
+            p = p->parent;
+        }
+        return p;
+    }
+
+    // Первый узел с ключом не меньше value (upper = false) или строго больше (upper = true)
+    node<T>* bound_node(const T& value, bool upper) const {
+        node<T>* result = nullptr;
+        node<T>* current = root;
+        while (current) {
+            bool go_left = upper ? value < current->data : !(current->data < value);
+            if (go_left) {
+                result = current; // Кандидат, ищем левее
+                current = current->left;
+            } else {
+                current = current->right;
+            }
+        }
+        return result;
+    }
+
     // Заменяет один поддерево другим (вспомогательная функция для удаления)
     void transplant(node<T>* u, node<T>* v) {
         if (!u->parent) root = v; // Если u - корень, v становится корнем
@@ -109,61 +175,64 @@ private:
     }
 
     // Восстановление свойств красно-чёрного дерева после удаления
-    void delete_fixup(node<T>* x) {
+    // xp - родитель x (x может быть nullptr, и тогда взять родителя из него нельзя)
+    void delete_fixup(node<T>* x, node<T>* xp) {
         // Цикл продолжается, пока x не корень и его цвет чёрный
         while (x != root && (!x || !x->is_red)) {
-            if (x == x->parent->left) { // Если x - левый потомок
-                node<T>* w = x->parent->right; // Брат x
+            if (x == xp->left) { // Если x - левый потомок
+                node<T>* w = xp->right; // Брат x
                 if (w && w->is_red) { // Если брат красный
                     w->is_red = false; // Красим брата в чёрный
-                    x->parent->is_red = true; // Красим родителя в красный
-                    left_rotate(x->parent); // Поворачиваем родителя
-                    w = x->parent->right; // Обновляем брата
+                    xp->is_red = true; // Красим родителя в красный
+                    left_rotate(xp); // Поворачиваем родителя
+                    w = xp->right; // Обновляем брата
                 }
                 // Если оба потомка брата чёрные
                 if (w && (!w->left || !w->left->is_red) && (!w->right || !w->right->is_red)) {
                     w->is_red = true; // Красим брата в красный
-                    x = x->parent;    // Поднимаемся выше
+                    x = xp;           // Поднимаемся выше
+                    xp = x->parent;
                 } else { // Если хотя бы один потомок брата красный
                     // Если правый потомок брата чёрный
                     if (w && (!w->right || !w->right->is_red)) {
                         if (w->left) w->left->is_red = false; // Красим левого потомка в чёрный
                         w->is_red = true; // Красим брата в красный
                         right_rotate(w); // Поворачиваем брата
-                        w = x->parent->right; // Обновляем брата
+                        w = xp->right; // Обновляем брата
                     }
                     // Красим брата в цвет родителя
                     if (w) {
-                        w->is_red = x->parent->is_red;
-                        x->parent->is_red = false; // Красим родителя в чёрный
+                        w->is_red = xp->is_red;
+                        xp->is_red = false; // Красим родителя в чёрный
                         if (w->right) w->right->is_red = false; // Красим правого потомка брата в чёрный
-                        left_rotate(x->parent); // Поворачиваем родителя
+                        left_rotate(xp); // Поворачиваем родителя
                         x = root; // Выходим из цикла
                     }
                 }
             } else { // Симметричный случай, если x - правый потомок
-                node<T>* w = x->parent->left; // Брат x
+                node<T>* w = xp->left; // Брат x
                 if (w && w->is_red) {
                     w->is_red = false;
-                    x->parent->is_red = true;
-                    right_rotate(x->parent);
-                    w = x->parent->left;
+                    xp->is_red = true;
+                    right_rotate(xp);
+                    w = xp->left;
                 }
                 if (w && (!w->right || !w->right->is_red) && (!w->left || !w->left->is_red)) {
                     w->is_red = true;
-                    x = x->parent;
+                    x = xp;
+                    xp = x->parent;
                 } else {
                     if (w && (!w->left || !w->left->is_red)) {
                         if (w->right) w->right->is_red = false;
                         w->is_red = true;
                         left_rotate(w);
-                        w = x->parent->left;
+                        w = xp->left;
                     }
                     if (w) {
-                        w->is_red = x->parent->is_red;
-                        x->parent->is_red = false;
+                        w->is_red = xp->is_red;
+                        xp->is_red = false;
                         if (w->left) w->left->is_red = false;
-                        right_rotate(x->parent);
+                        right_rotate(xp);
                         x = root;
                     }
                 }
@@ -172,23 +241,326 @@ private:
         if (x) x->is_red = false; // Красим x в чёрный
     }
 
-    // Рекурсивно удаляет все узлы дерева
-    void clear(node<T>* n) {
-        if (!n) return; // Если узел пуст, выходим
-        clear(n->left);  // Удаляем левое поддерево
-        clear(n->right); // Удаляем правое поддерево
-        delete n;        // Удаляем сам узел
+    // Удаляет поддерево за O(n) без рекурсии: левые потомки поворотами
+    // переносятся в правую цепочку, узел без левого потомка сразу удаляется
+    static void clear(node<T>* n) {
+        while (n) {
+            if (n->left) {
+                node<T>* l = n->left; // Поворот вправо вокруг n
+                n->left = l->right;
+                l->right = n;
+                n = l;
+            } else {
+                node<T>* r = n->right;
+                delete n;
+                n = r;
+            }
+        }
+    }
+
+    // Рекурсивно копирует поддерево вместе с цветами и размерами
+    static node<T>* copy(const node<T>* n, node<T>* parent) {
+        if (!n) return nullptr;
+        node<T>* c = new node<T>(n->data, parent, nullptr, nullptr, n->is_red);
+        c->count = n->count;
+        c->left = copy(n->left, c);
+        c->right = copy(n->right, c);
+        return c;
     }
 
-    // Считает количество узлов в дереве
-    size_t count_nodes(node<T>* n) const {
-        if (!n) return 0; // Если узел пуст, возвращаем 0
-        return 1 + count_nodes(n->left) + count_nodes(n->right); // Считаем узел + левое + правое поддеревья
+    // Самостоятельное красно-чёрное дерево: корень (чёрный, без родителя) и чёрная высота.
+    // Чёрная высота - число чёрных узлов на любом пути от корня вниз (у пустого дерева 0)
+    struct part {
+        node<T>* root;
+        int bh;
+    };
+
+    // Результат разрезания: элементы меньше ключа, узел с ключом (если был), элементы больше
+    struct split_result {
+        part left;
+        node<T>* mid;
+        part right;
+    };
+
+    // Поддеревья меньше этого размера обрабатываются в одном потоке
+    static constexpr size_t parallel_cutoff = 1 << 15;
+
+    // Чёрная высота потомка узла n, если чёрная высота n равна h
+    static int child_bh(node<T>* n, int h) {
+        return n->is_red ? h : h - 1;
+    }
+
+    // Отрезает поддерево n от родителя; красный корень перекрашивается, высота растёт
+    static part detach(node<T>* n, int h) {
+        if (!n) return {nullptr, 0};
+        n->parent = nullptr;
+        if (n->is_red) {
+            n->is_red = false;
+            h++;
+        }
+        return {n, h};
     }
 
+    // Склейка l, k, r (все ключи l < k < все ключи r) за O(|bh(l) - bh(r)|):
+    // спускаемся по краю более высокого дерева до чёрного узла нужной высоты,
+    // подвешиваем туда красный k и чиним дерево как после обычной вставки
+    static part join(part l, node<T>* k, part r) {
+        if (l.bh == r.bh) {
+            k->left = l.root;
+            k->right = r.root;
+            if (l.root) l.root->parent = k;
+            if (r.root) r.root->parent = k;
+            k->parent = nullptr;
+            k->is_red = false;
+            update_count(k);
+            return {k, l.bh + 1};
+        }
+
+        // Ищем на краю более высокого дерева чёрный узел x с чёрной высотой меньшего
+        bool right_edge = l.bh > r.bh;
+        part high = right_edge ? l : r;
+        int low_bh = right_edge ? r.bh : l.bh;
+        node<T>* x = high.root;
+        node<T>* p = nullptr;
+        int h = high.bh;
+        while (x && (x->is_red || h > low_bh)) {
+            if (!x->is_red) h--;
+            p = x;
+            x = right_edge ? x->right : x->left;
+        }
+
+        // Красный k встаёт на место x, x и меньшее дерево - его потомки
+        if (right_edge) {
+            k->left = x;
+            k->right = r.root;
+            p->right = k;
+        } else {
+            k->left = l.root;
+            k->right = x;
+            p->left = k;
+        }
+        k->parent = p;
+        k->is_red = true;
+        if (k->left) k->left->parent = k;
+        if (k->right) k->right->parent = k;
+        update_count(k);
+        size_t added = k->count - subtree_size(x); // Столько узлов добавилось каждому предку
+        for (node<T>* a = p; a; a = a->parent) a->count += added;
+
+        tree<T> t; // Временное дерево, чтобы воспользоваться поворотами и insert_fixup
+        t.root = high.root;
+        int grew = t.insert_fixup(k) ? 1 : 0;
+        part result{t.root, high.bh + grew};
+        t.root = nullptr; // Узлы принадлежат результату, а не временному дереву
+        return result;
+    }
+
+    // Склейка без разделяющего ключа: им становится максимум l
+    static part join2(part l, part r) {
+        if (!l.root) return r;
+        if (!r.root) return l;
+        node<T>* last = nullptr;
+        part rest = split_last(l, last);
+        return join(rest, last, r);
+    }
+
+    // Отрезает максимальный узел дерева t
+    static part split_last(part t, node<T>*& last) {
+        node<T>* n = t.root;
+        int hc = child_bh(n, t.bh);
+        part left = detach(n->left, hc);
+        part right = detach(n->right, hc);
+        if (!right.root) {
+            n->left = n->right = nullptr;
+            n->count = 1;
+            last = n;
+            return left;
+        }
+        part rest = split_last(right, last);
+        return join(left, n, rest);
+    }
+
+    // Разрезание по key за O(log n): спуск к key, по пути обратно склеиваем отрезанные части
+    static split_result split(part t, const T& key) {
+        if (!t.root) return {{nullptr, 0}, nullptr, {nullptr, 0}};
+        node<T>* n = t.root;
+        int hc = child_bh(n, t.bh);
+        part left = detach(n->left, hc);
+        part right = detach(n->right, hc);
+        if (key < n->data) {
+            split_result s = split(left, key);
+            return {s.left, s.mid, join(s.right, n, right)};
+        }
+        if (n->data < key) {
+            split_result s = split(right, key);
+            return {join(left, n, s.left), s.mid, s.right};
+        }
+        n->left = n->right = nullptr;
+        n->count = 1;
+        return {left, n, right};
+    }
+
+    // Запускает две ветви рекурсии: в разных потоках, если разрешено, иначе подряд
+    template <typename F, typename G>
+    static void fork(bool parallel, F left, G right) {
+        if (parallel) {
+            std::thread worker(left);
+            right();
+            worker.join();
+        } else {
+            left();
+            right();
+        }
+    }
+
+    static bool worth_forking(int spawn, part a, part b) {
+        return spawn > 0 && subtree_size(a.root) + subtree_size(b.root) >= parallel_cutoff;
+    }
+
+    // Объединение: корень a делит b пополам, половины объединяются рекурсивно.
+    // Всего O(m log(n/m + 1)), где m - размер меньшего дерева
+    static part unite(part a, part b, int spawn) {
+        if (!a.root) return b;
+        if (!b.root) return a;
+        bool parallel = worth_forking(spawn, a, b); // Пока размеры ещё не изменены
+        node<T>* k = a.root;
+        int hc = child_bh(k, a.bh);
+        part al = detach(k->left, hc);
+        part ar = detach(k->right, hc);
+        split_result s = split(b, k->data);
+        delete s.mid; // Дубликат ключа k
+        part l, r;
+        fork(parallel,
+             [&] { l = unite(al, s.left, spawn - 1); },
+             [&] { r = unite(ar, s.right, spawn - 1); });
+        return join(l, k, r);
+    }
+
+    // Пересечение: остаются ключи a, найденные в b
+    static part intersect(part a, part b, int spawn) {
+        if (!a.root || !b.root) {
+            clear(a.root);
+            clear(b.root);
+            return {nullptr, 0};
+        }
+        bool parallel = worth_forking(spawn, a, b); // Пока размеры ещё не изменены
+        node<T>* k = a.root;
+        int hc = child_bh(k, a.bh);
+        part al = detach(k->left, hc);
+        part ar = detach(k->right, hc);
+        split_result s = split(b, k->data);
+        part l, r;
+        fork(parallel,
+             [&] { l = intersect(al, s.left, spawn - 1); },
+             [&] { r = intersect(ar, s.right, spawn - 1); });
+        if (s.mid) {
+            delete s.mid;
+            return join(l, k, r);
+        }
+        delete k;
+        return join2(l, r);
+    }
+
+    // Разность: ключи a, которых нет в b; делим a корнем b
+    static part subtract(part a, part b, int spawn) {
+        if (!a.root || !b.root) {
+            clear(b.root);
+            return a;
+        }
+        bool parallel = worth_forking(spawn, a, b); // Пока размеры ещё не изменены
+        node<T>* k = b.root;
+        int hc = child_bh(k, b.bh);
+        part bl = detach(k->left, hc);
+        part br = detach(k->right, hc);
+        split_result s = split(a, k->data);
+        delete k;
+        delete s.mid; // Ключ есть в b, из результата он уходит
+        part l, r;
+        fork(parallel,
+             [&] { l = subtract(s.left, bl, spawn - 1); },
+             [&] { r = subtract(s.right, br, spawn - 1); });
+        return join2(l, r);
+    }
+
+    // Число уровней рекурсии, на которых ещё можно отдавать ветви новым потокам
+    static int spawn_levels(unsigned threads) {
+        int levels = 0;
+        while ((1u << levels) < threads) levels++;
+        return levels;
+    }
+
+    // Текущее содержимое как самостоятельное дерево; само дерево становится пустым
+    part take() {
+        int h = 0;
+        for (node<T>* x = root; x; x = x->left) {
+            if (!x->is_red) h++;
+        }
+        part result{root, h};
+        root = nullptr;
+        return result;
+    }
+
+
 public:
+    // Двунаправленный итератор по возрастанию; end() - nullptr,
+    // поэтому для шага назад от end() нужен указатель на дерево
+    class iterator {
+    private:
+        node<T>* n;
+        const tree* owner;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        iterator(node<T>* x, const tree* t) : n(x), owner(t) {}
+
+        reference operator*() const { return n->data; }
+        pointer operator->() const { return &n->data; }
+
+        iterator& operator++() {
+            n = successor(n);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        iterator& operator--() {
+            n = n ? predecessor(n) : maximum(owner->root);
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const { return n == other.n; }
+        bool operator!=(const iterator& other) const { return n != other.n; }
+    };
+
     tree() = default; // Конструктор по умолчанию
 
+    // Копирование - полная копия узлов
+    tree(const tree& other) : root(copy(other.root, nullptr)) {}
+
+    tree& operator=(const tree& other) {
+        if (this != &other) {
+            node<T>* c = copy(other.root, nullptr);
+            clear(root);
+            root = c;
+        }
+        return *this;
+    }
+
     // Деструктор - вызывает clear
     ~tree() {
         clear(root);
@@ -220,6 +592,7 @@ public:
         z->left = nullptr; // Инициализируем потомков
         z->right = nullptr;
         z->is_red = true; // Новый узел всегда красный
+        for (node<T>* p = parent; p; p = p->parent) p->count++; // Все предки получили ещё один узел
         insert_fixup(z); // Исправляем нарушения свойств дерева
     }
 
@@ -234,16 +607,24 @@ public:
 
         node<T>* y = z; // y - узел, который будет физически удалён
         node<T>* x = nullptr; // x - узел, который будет перемещён на место y
+        node<T>* x_parent = nullptr; // Родитель x после удаления
         bool y_original_color = y->is_red; // Запоминаем цвет удаляемого узла
 
+        // Физически из дерева уходит z, либо его преемник, если у z два потомка;
+        // все предки этого места теряют по одному узлу
+        node<T>* removed = (z->left && z->right) ? minimum(z->right) : z;
+        for (node<T>* p = removed->parent; p; p = p->parent) p->count--;
+
         // Случай 1: у z нет левого потомка
         if (!z->left) {
             x = z->right; // x - правый потомок z
+            x_parent = z->parent;
             transplant(z, z->right); // Заменяем z на x
         }
         // Случай 2: у z нет правого потомка
         else if (!z->right) {
             x = z->left; // x - левый потомок z
+            x_parent = z->parent;
             transplant(z, z->left); // Заменяем z на x
         }
         // Случай 3: у z есть оба потомка
@@ -253,7 +634,9 @@ public:
             x = y->right; // x - правый потомок y
             if (y->parent == z) { // Если y - непосредственный потомок z
                 if (x) x->parent = y; // Обновляем родителя x
+                x_parent = y;
             } else { // Если y глубже в поддереве
+                x_parent = y->parent;
                 transplant(y, y->right); // Заменяем y его правым потомком
                 y->right = z->right;     // y получает правое поддерево z
                 y->right->parent = y;
@@ -262,10 +645,11 @@ public:
             y->left = z->left; // y получает левое поддерево z
             y->left->parent = y;
             y->is_red = z->is_red; // y получает цвет z
+            y->count = z->count;   // и размер поддерева z
         }
 
         // Если удаляемый узел был чёрным, нужно восстановить свойства дерева
-        if (!y_original_color) delete_fixup(x);
+        if (!y_original_color) delete_fixup(x, x_parent);
         delete z; // Удаляем сам узел z
     }
 
@@ -285,9 +669,79 @@ public:
         return root == nullptr;
     }
 
-    // Возвращает количество элементов в дереве
+    // Возвращает количество элементов в дереве (O(1), размер хранится в корне)
     size_t size() const {
-        return count_nodes(root);
+        return subtree_size(root);
+    }
+
+    // Количество элементов, строго меньших value (O(log n))
+    size_t rank(const T& value) const {
+        size_t result = 0;
+        node<T>* current = root;
+        while (current) {
+            if (current->data < value) {
+                result += subtree_size(current->left) + 1; // Левое поддерево и сам узел меньше value
+                current = current->right;
+            } else {
+                current = current->left;
+            }
+        }
+        return result;
+    }
+
+    // k-й по порядку элемент, начиная с 0 (O(log n))
+    const T& select(size_t k) const {
+        if (k >= size()) throw std::out_of_range("tree::select");
+        node<T>* current = root;
+        while (true) {
+            size_t left_size = subtree_size(current->left);
+            if (k < left_size) current = current->left;
+            else if (k == left_size) return current->data;
+            else {
+                k -= left_size + 1; // Пропускаем левое поддерево и сам узел
+                current = current->right;
+            }
+        }
+    }
+
+    // Разрезает дерево по key: в left уходят элементы меньше key, в right - больше.
+    // Само дерево становится пустым; возвращает true, если key в нём был
+    bool split(const T& key, tree& left, tree& right) {
+        split_result s = split(take(), key);
+        bool found = s.mid != nullptr;
+        delete s.mid;
+        left.clear();
+        right.clear();
+        left.root = s.left.root;
+        right.root = s.right.root;
+        return found;
+    }
+
+    // Заменяет содержимое склейкой left, key и right (элементы left < key < элементы right).
+    // left и right становятся пустыми
+    void join(tree& left, const T& key, tree& right) {
+        part l = left.take();
+        part r = right.take();
+        clear();
+        root = join(l, new node<T>(key), r).root;
+    }
+
+    // Объединение с other; other становится пустым
+    void union_with(tree& other, unsigned threads = std::thread::hardware_concurrency()) {
+        part a = take();
+        root = unite(a, other.take(), spawn_levels(threads)).root;
+    }
+
+    // Пересечение с other; other становится пустым
+    void intersect_with(tree& other, unsigned threads = std::thread::hardware_concurrency()) {
+        part a = take();
+        root = intersect(a, other.take(), spawn_levels(threads)).root;
+    }
+
+    // Убирает элементы, которые есть в other; other становится пустым
+    void difference(tree& other, unsigned threads = std::thread::hardware_concurrency()) {
+        part a = take();
+        root = subtract(a, other.take(), spawn_levels(threads)).root;
     }
 
     // Удаляет все элементы из дерева
@@ -296,24 +750,987 @@ public:
         root = nullptr;
     }
 
-    // Возвращает узел с минимальным значением (для итератора)
-    node<T>* begin_node() const {
-        return minimum(root);
+    // Первый элемент не меньше value (O(log n))
+    iterator lower_bound(const T& value) const {
+        return iterator(bound_node(value, false), this);
+    }
+
+    // Первый элемент строго больше value (O(log n))
+    iterator upper_bound(const T& value) const {
+        return iterator(bound_node(value, true), this);
+    }
+
+    // Количество элементов в [lo, hi) - разность рангов, O(log n) без обхода
+    size_t count_range(const T& lo, const T& hi) const {
+        if (!(lo < hi)) return 0;
+        return rank(hi) - rank(lo);
+    }
+
+    iterator begin() const {
+        return iterator(minimum(root), this);
+    }
+
+    iterator end() const {
+        return iterator(nullptr, this);
+    }
+};
+
+// Поиск в отсортированном массиве ключей узла: позиция первого ключа, не меньшего value.
+// Общий случай - двоичный поиск
+template <typename T>
+size_t key_lower_index(const T* keys, size_t n, const T& value) {
+    return std::lower_bound(keys, keys + n, value) - keys;
+}
+
+// Для чисел - сравнение сразу 8 (AVX2) или 4 (SSE2) ключей: маска "ключ < value"
+// в отсортированном массиве - это единицы подряд с младшего бита, число единиц и есть сдвиг
+inline size_t key_lower_index(const int32_t* keys, size_t n, const int32_t& value) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i v = _mm256_set1_epi32(value);
+    for (; i + 8 <= n; i += 8) {
+        __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, k)));
+        if (mask != 0xFF) return i + __builtin_ctz(~mask);
+    }
+#elif defined(__SSE2__)
+    __m128i v = _mm_set1_epi32(value);
+    for (; i + 4 <= n; i += 4) {
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k)));
+        if (mask != 0xF) return i + __builtin_ctz(~mask);
+    }
+#endif
+    while (i < n && keys[i] < value) ++i; // Хвост короче вектора
+    return i;
+}
+
+inline size_t key_lower_index(const int64_t* keys, size_t n, const int64_t& value) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i v = _mm256_set1_epi64x(value);
+    for (; i + 4 <= n; i += 4) {
+        __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, k)));
+        if (mask != 0xF) return i + __builtin_ctz(~mask);
+    }
+#endif
+    while (i < n && keys[i] < value) ++i;
+    return i;
+}
+
+inline size_t key_lower_index(const float* keys, size_t n, const float& value) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256 v = _mm256_set1_ps(value);
+    for (; i + 8 <= n; i += 8) {
+        unsigned mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(keys + i), v, _CMP_LT_OQ));
+        if (mask != 0xFF) return i + __builtin_ctz(~mask);
+    }
+#elif defined(__SSE2__)
+    __m128 v = _mm_set1_ps(value);
+    for (; i + 4 <= n; i += 4) {
+        unsigned mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys + i), v));
+        if (mask != 0xF) return i + __builtin_ctz(~mask);
+    }
+#endif
+    while (i < n && keys[i] < value) ++i;
+    return i;
+}
+
+inline size_t key_lower_index(const double* keys, size_t n, const double& value) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256d v = _mm256_set1_pd(value);
+    for (; i + 4 <= n; i += 4) {
+        unsigned mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(keys + i), v, _CMP_LT_OQ));
+        if (mask != 0xF) return i + __builtin_ctz(~mask);
+    }
+#elif defined(__SSE2__)
+    __m128d v = _mm_set1_pd(value);
+    for (; i + 2 <= n; i += 2) {
+        unsigned mask = _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(keys + i), v));
+        if (mask != 0x3) return i + __builtin_ctz(~mask);
+    }
+#endif
+    while (i < n && keys[i] < value) ++i;
+    return i;
+}
+
+// Степень B-дерева по умолчанию: ключи узла занимают около 256 байт (4 кэш-линии)
+template <typename T>
+constexpr size_t default_btree_degree() {
+    return 128 / sizeof(T) > 2 ? 128 / sizeof(T) : 2;
+}
+
+// B-дерево: широкие узлы, ключи лежат подряд в одном массиве.
+// Каждый узел, кроме корня, хранит от B-1 до 2B-1 ключей
+template <typename T, size_t B = default_btree_degree<T>()>
+class btree {
+private:
+    static constexpr size_t max_keys = 2 * B - 1;
+
+    // Лист: только ключи
+    struct alignas(64) leaf_node {
+        size_t count = 0;      // Количество элементов в поддереве
+        uint16_t n = 0;        // Количество ключей в узле
+        bool is_leaf = true;   // Лист или внутренний узел
+        T keys[max_keys];      // Ключи по возрастанию
+    };
+
+    // Внутренний узел: ключи и n + 1 потомков
+    struct inner_node : leaf_node {
+        leaf_node* children[max_keys + 1];
+
+        inner_node() { this->is_leaf = false; }
+    };
+
+    leaf_node* root = nullptr; // Корень дерева
+
+    static inner_node* inner(leaf_node* x) {
+        return static_cast<inner_node*>(x);
+    }
+
+    static leaf_node* child(leaf_node* x, size_t i) {
+        return inner(x)->children[i];
+    }
+
+    // Позиция первого ключа, не меньшего value (для чисел - векторный поиск)
+    static size_t lower_index(const leaf_node* x, const T& value) {
+        return key_lower_index(x->keys, x->n, value);
+    }
+
+    // Позиция первого ключа, большего value
+    static size_t upper_index(const leaf_node* x, const T& value) {
+        return std::upper_bound(x->keys, x->keys + x->n, value) - x->keys;
+    }
+
+    static void destroy(leaf_node* x) {
+        if (x->is_leaf) delete x;
+        else delete inner(x);
+    }
+
+    // Количество элементов в потомках [0, i)
+    static size_t children_count(leaf_node* x, size_t i) {
+        if (x->is_leaf) return 0;
+        size_t result = 0;
+        for (size_t j = 0; j < i; ++j) result += child(x, j)->count;
+        return result;
+    }
+
+    // Пересчитывает размер поддерева по ключам и потомкам
+    static void update_count(leaf_node* x) {
+        x->count = x->n + children_count(x, x->n + 1);
+    }
+
+    // Делит полного потомка i узла x пополам, средний ключ поднимается в x
+    void split_child(leaf_node* x, size_t i) {
+        leaf_node* y = child(x, i);
+        leaf_node* z = y->is_leaf ? new leaf_node : new inner_node;
+        z->n = B - 1;
+        std::move(y->keys + B, y->keys + max_keys, z->keys); // Правая половина ключей
+        if (!y->is_leaf) {
+            std::copy(inner(y)->children + B, inner(y)->children + max_keys + 1, inner(z)->children);
+        }
+        y->n = B - 1;
+        update_count(y);
+        update_count(z);
+
+        // Сдвигаем ключи и потомков x, освобождая место
+        std::move_backward(x->keys + i, x->keys + x->n, x->keys + x->n + 1);
+        std::copy_backward(inner(x)->children + i + 1, inner(x)->children + x->n + 1,
+                           inner(x)->children + x->n + 2);
+        x->keys[i] = std::move(y->keys[B - 1]);
+        inner(x)->children[i + 1] = z;
+        x->n++;
+    }
+
+    // Вставка в узел, который точно не полон; value в дереве нет
+    void insert_nonfull(leaf_node* x, const T& value) {
+        while (true) {
+            x->count++; // Элемент попадёт в это поддерево
+            size_t i = lower_index(x, value);
+            if (x->is_leaf) {
+                std::move_backward(x->keys + i, x->keys + x->n, x->keys + x->n + 1);
+                x->keys[i] = value;
+                x->n++;
+                return;
+            }
+            if (child(x, i)->n == max_keys) {
+                split_child(x, i);
+                if (x->keys[i] < value) i++;
+            }
+            x = child(x, i);
+        }
+    }
+
+    // Сливает потомков i и i + 1 узла x вместе с ключом x->keys[i]
+    void merge_children(leaf_node* x, size_t i) {
+        leaf_node* y = child(x, i);
+        leaf_node* z = child(x, i + 1);
+        y->keys[y->n] = std::move(x->keys[i]);
+        std::move(z->keys, z->keys + z->n, y->keys + y->n + 1);
+        if (!y->is_leaf) {
+            std::copy(inner(z)->children, inner(z)->children + z->n + 1, inner(y)->children + y->n + 1);
+        }
+        y->n += z->n + 1;
+        y->count += z->count + 1;
+
+        std::move(x->keys + i + 1, x->keys + x->n, x->keys + i);
+        std::copy(inner(x)->children + i + 2, inner(x)->children + x->n + 1, inner(x)->children + i + 1);
+        x->n--;
+        destroy(z);
+    }
+
+    // Гарантирует, что у потомка i не меньше B ключей; возвращает его новый индекс
+    size_t fill_child(leaf_node* x, size_t i) {
+        leaf_node* c = child(x, i);
+        if (c->n >= B) return i;
+
+        if (i > 0 && child(x, i - 1)->n >= B) { // Занимаем ключ у левого брата
+            leaf_node* l = child(x, i - 1);
+            std::move_backward(c->keys, c->keys + c->n, c->keys + c->n + 1);
+            c->keys[0] = std::move(x->keys[i - 1]);
+            x->keys[i - 1] = std::move(l->keys[l->n - 1]);
+            size_t moved = 1;
+            if (!c->is_leaf) {
+                std::copy_backward(inner(c)->children, inner(c)->children + c->n + 1,
+                                   inner(c)->children + c->n + 2);
+                inner(c)->children[0] = inner(l)->children[l->n];
+                moved += inner(c)->children[0]->count;
+            }
+            c->n++;
+            l->n--;
+            c->count += moved;
+            l->count -= moved;
+            return i;
+        }
+        if (i < x->n && child(x, i + 1)->n >= B) { // Занимаем ключ у правого брата
+            leaf_node* r = child(x, i + 1);
+            c->keys[c->n] = std::move(x->keys[i]);
+            x->keys[i] = std::move(r->keys[0]);
+            std::move(r->keys + 1, r->keys + r->n, r->keys);
+            size_t moved = 1;
+            if (!c->is_leaf) {
+                inner(c)->children[c->n + 1] = inner(r)->children[0];
+                moved += inner(c)->children[c->n + 1]->count;
+                std::copy(inner(r)->children + 1, inner(r)->children + r->n + 1, inner(r)->children);
+            }
+            c->n++;
+            r->n--;
+            c->count += moved;
+            r->count -= moved;
+            return i;
+        }
+        // Оба брата минимальны - сливаем
+        if (i < x->n) {
+            merge_children(x, i);
+            return i;
+        }
+        merge_children(x, i - 1);
+        return i - 1;
+    }
+
+    // Удаление из поддерева x; value точно есть, у x (кроме корня) не меньше B ключей
+    void erase_from(leaf_node* x, const T& value) {
+        while (true) {
+            x->count--;
+            size_t i = lower_index(x, value);
+            bool found = i < x->n && !(value < x->keys[i]);
+            if (x->is_leaf) {
+                std::move(x->keys + i + 1, x->keys + x->n, x->keys + i);
+                x->n--;
+                return;
+            }
+            if (found) {
+                leaf_node* l = child(x, i);
+                leaf_node* r = child(x, i + 1);
+                if (l->n >= B) { // Заменяем предшественником
+                    leaf_node* p = l;
+                    while (!p->is_leaf) p = child(p, p->n);
+                    x->keys[i] = p->keys[p->n - 1];
+                    erase_from(l, x->keys[i]);
+                    return;
+                }
+                if (r->n >= B) { // Заменяем преемником
+                    leaf_node* p = r;
+                    while (!p->is_leaf) p = child(p, 0);
+                    x->keys[i] = p->keys[0];
+                    erase_from(r, x->keys[i]);
+                    return;
+                }
+                merge_children(x, i); // Ключ уходит в слитый узел
+                x = child(x, i);
+                continue;
+            }
+            x = child(x, fill_child(x, i));
+        }
+    }
+
+    void clear(leaf_node* x) {
+        if (!x) return;
+        if (!x->is_leaf) {
+            for (size_t i = 0; i <= x->n; ++i) clear(child(x, i));
+        }
+        destroy(x);
+    }
+
+public:
+    btree() = default;
+    btree(const btree&) = delete;
+    btree& operator=(const btree&) = delete;
+
+    ~btree() {
+        clear(root);
+    }
+
+    void insert(const T& value) {
+        if (contains(value)) return; // Дубликаты не храним
+        if (!root) root = new leaf_node;
+        if (root->n == max_keys) { // Полный корень делится, дерево растёт вверх
+            inner_node* s = new inner_node;
+            s->children[0] = root;
+            s->count = root->count;
+            root = s;
+            split_child(s, 0);
+        }
+        insert_nonfull(root, value);
+    }
+
+    void erase(const T& value) {
+        if (!contains(value)) return;
+        erase_from(root, value);
+        if (root->n == 0) { // Корень опустел: поднимаем единственного потомка
+            leaf_node* old = root;
+            root = root->is_leaf ? nullptr : child(root, 0);
+            destroy(old);
+        }
+    }
+
+    bool contains(const T& value) const {
+        leaf_node* x = root;
+        while (x) {
+            size_t i = lower_index(x, value);
+            if (i < x->n && !(value < x->keys[i])) return true;
+            if (x->is_leaf) return false;
+            x = child(x, i);
+        }
+        return false;
+    }
+
+    bool empty() const {
+        return root == nullptr;
+    }
+
+    size_t size() const {
+        return root ? root->count : 0;
+    }
+
+private:
+    // Узел и позиция в нём для k-го по порядку элемента (k < size())
+    void locate(size_t k, leaf_node*& x, size_t& slot) const {
+        x = root;
+        while (true) {
+            if (x->is_leaf) {
+                slot = k;
+                return;
+            }
+            for (size_t j = 0; ; ++j) {
+                size_t c = child(x, j)->count;
+                if (k < c) {
+                    x = child(x, j);
+                    break;
+                }
+                if (k == c) {
+                    slot = j;
+                    return;
+                }
+                k -= c + 1;
+            }
+        }
+    }
+
+public:
+    // Двунаправленный итератор: хранит путь от корня (узел, номер потомка или ключа),
+    // последний элемент пути - текущий ключ. Шаг внутри листа - O(1), переход между
+    // узлами - подъём или спуск по пути, в среднем тоже O(1) на шаг
+    class iterator {
+    private:
+        const btree* owner;
+        size_t pos;                                      // Номер элемента, size() - конец
+        std::vector<std::pair<leaf_node*, size_t>> path; // Пуст для конца
+
+        void seek(size_t k) {
+            pos = k;
+            path.clear();
+            if (k >= owner->size()) return;
+            leaf_node* x = owner->root;
+            while (!x->is_leaf) {
+                size_t j = 0;
+                for (; ; ++j) {
+                    size_t c = child(x, j)->count;
+                    if (k <= c) break;
+                    k -= c + 1;
+                }
+                path.emplace_back(x, j);
+                if (k == child(x, j)->count) return; // Ключ j внутреннего узла
+                x = child(x, j);
+            }
+            path.emplace_back(x, k);
+        }
+
+        // Спуск от потомка i узла на вершине пути до самого левого (правого) ключа
+        void descend(size_t i, bool leftmost) {
+            path.back().second = i;
+            leaf_node* x = child(path.back().first, i);
+            while (!x->is_leaf) {
+                size_t j = leftmost ? 0 : x->n;
+                path.emplace_back(x, j);
+                x = child(x, j);
+            }
+            path.emplace_back(x, leftmost ? 0 : x->n - 1);
+        }
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        iterator(const btree* t, size_t k) : owner(t) { seek(k); }
+
+        reference operator*() const { return path.back().first->keys[path.back().second]; }
+        pointer operator->() const { return &**this; }
+
+        iterator& operator++() {
+            ++pos;
+            leaf_node* x = path.back().first;
+            size_t& slot = path.back().second;
+            if (!x->is_leaf) {
+                descend(slot + 1, true); // Следующий - самый левый в правом потомке ключа
+            } else if (slot + 1 < x->n) {
+                ++slot;
+            } else {
+                // Лист кончился: вверх до первого узла, где пришли не из последнего потомка
+                path.pop_back();
+                while (!path.empty() && path.back().second == path.back().first->n) {
+                    path.pop_back();
+                }
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        iterator& operator--() {
+            if (path.empty()) { // От конца - к последнему элементу
+                seek(pos - 1);
+                return *this;
+            }
+            --pos;
+            leaf_node* x = path.back().first;
+            size_t& slot = path.back().second;
+            if (!x->is_leaf) {
+                descend(slot, false); // Предыдущий - самый правый в левом потомке ключа
+            } else if (slot > 0) {
+                --slot;
+            } else {
+                path.pop_back();
+                while (path.back().second == 0) {
+                    path.pop_back();
+                }
+                --path.back().second; // Пришли из потомка i - предыдущий ключ i - 1
+            }
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const { return pos == other.pos; }
+        bool operator!=(const iterator& other) const { return pos != other.pos; }
+    };
+
+    // Количество элементов, строго меньших value
+    size_t rank(const T& value) const {
+        size_t result = 0;
+        leaf_node* x = root;
+        while (x) {
+            size_t i = lower_index(x, value);
+            result += i + children_count(x, i);
+            if (x->is_leaf) break;
+            if (i < x->n && !(value < x->keys[i])) { // Весь потомок i меньше value
+                result += child(x, i)->count;
+                break;
+            }
+            x = child(x, i);
+        }
+        return result;
+    }
+
+    // k-й по порядку элемент, начиная с 0
+    const T& select(size_t k) const {
+        if (k >= size()) throw std::out_of_range("btree::select");
+        leaf_node* x;
+        size_t slot;
+        locate(k, x, slot);
+        return x->keys[slot];
+    }
+
+    void clear() {
+        clear(root);
+        root = nullptr;
+    }
+
+    // Количество элементов, не больших value
+    size_t upper_rank(const T& value) const {
+        size_t result = 0;
+        leaf_node* x = root;
+        while (x) {
+            size_t i = upper_index(x, value);
+            result += i + children_count(x, i);
+            if (x->is_leaf) break;
+            x = child(x, i);
+        }
+        return result;
     }
 
-    // Возвращает "итератор" на конец (nullptr)
-    node<T>* end_node() const {
-        return nullptr; // "итератор" на конец — всегда nullptr
+    // Границы через ранги: O(log n) спуск и переход итератора к позиции
+    iterator lower_bound(const T& value) const {
+        return iterator(this, rank(value));
+    }
+
+    iterator upper_bound(const T& value) const {
+        return iterator(this, upper_rank(value));
+    }
+
+    size_t count_range(const T& lo, const T& hi) const {
+        if (!(lo < hi)) return 0;
+        return rank(hi) - rank(lo);
+    }
+
+    iterator begin() const {
+        return iterator(this, 0);
+    }
+
+    iterator end() const {
+        return iterator(this, size());
     }
 };
 
-// Обёртка my_set
+// Компактное красно-чёрное дерево: узлы лежат в одном векторе и ссылаются друг на друга
+// 32-битными индексами, цвет - старший бит индекса родителя. Узел int занимает 16 байт
+// (у tree<int> - 48), поэтому в кэш помещается втрое больше дерева, а копирование -
+// это копия вектора. Размеров поддеревьев нет, так что rank/select не поддерживаются
 template <typename T>
+class compact_tree {
+private:
+    static constexpr uint32_t none = 0x7fffffff;    // Отсутствующий узел (как nullptr)
+    static constexpr uint32_t red_bit = 0x80000000; // Цвет в индексе родителя
+
+    struct cnode {
+        T data;
+        uint32_t left;
+        uint32_t right;
+        uint32_t parent_red; // Индекс родителя и бит цвета
+    };
+
+    std::vector<cnode> pool;   // Все узлы; индекс узла - позиция в pool
+    uint32_t free_head = none; // Освобождённые узлы, связанные через left
+    uint32_t root = none;
+    size_t count = 0;
+
+    uint32_t& left(uint32_t x) { return pool[x].left; }
+    uint32_t& right(uint32_t x) { return pool[x].right; }
+    uint32_t left(uint32_t x) const { return pool[x].left; }
+    uint32_t right(uint32_t x) const { return pool[x].right; }
+
+    uint32_t parent(uint32_t x) const {
+        return pool[x].parent_red & ~red_bit;
+    }
+
+    void set_parent(uint32_t x, uint32_t p) {
+        pool[x].parent_red = p | (pool[x].parent_red & red_bit);
+    }
+
+    bool is_red(uint32_t x) const {
+        return x != none && (pool[x].parent_red & red_bit);
+    }
+
+    void set_red(uint32_t x, bool red) {
+        pool[x].parent_red = parent(x) | (red ? red_bit : 0);
+    }
+
+    // Новый красный лист; берётся из списка свободных или дописывается в pool
+    uint32_t allocate(const T& value, uint32_t p) {
+        cnode n{value, none, none, p | red_bit};
+        if (free_head != none) {
+            uint32_t x = free_head;
+            free_head = pool[x].left;
+            pool[x] = std::move(n);
+            return x;
+        }
+        if (pool.size() == none) throw std::length_error("compact_tree: слишком много узлов");
+        pool.push_back(std::move(n));
+        return static_cast<uint32_t>(pool.size() - 1);
+    }
+
+    void release(uint32_t x) {
+        pool[x].left = free_head;
+        free_head = x;
+    }
+
+    uint32_t minimum(uint32_t x) const {
+        while (x != none && left(x) != none) x = left(x);
+        return x;
+    }
+
+    uint32_t maximum(uint32_t x) const {
+        while (x != none && right(x) != none) x = right(x);
+        return x;
+    }
+
+    uint32_t successor(uint32_t x) const {
+        if (right(x) != none) return minimum(right(x));
+        uint32_t p = parent(x);
+        while (p != none && x == right(p)) {
+            x = p;
+            p = parent(p);
+        }
+        return p;
+    }
+
+    uint32_t predecessor(uint32_t x) const {
+        if (left(x) != none) return maximum(left(x));
+        uint32_t p = parent(x);
+        while (p != none && x == left(p)) {
+            x = p;
+            p = parent(p);
+        }
+        return p;
+    }
+
+    // Ставит y на место x в родителе x
+    void replace_child(uint32_t x, uint32_t y) {
+        uint32_t p = parent(x);
+        if (p == none) root = y;
+        else if (x == left(p)) left(p) = y;
+        else right(p) = y;
+    }
+
+    void left_rotate(uint32_t x) {
+        uint32_t y = right(x);
+        right(x) = left(y);
+        if (left(y) != none) set_parent(left(y), x);
+        set_parent(y, parent(x));
+        replace_child(x, y);
+        left(y) = x;
+        set_parent(x, y);
+    }
+
+    void right_rotate(uint32_t x) {
+        uint32_t y = left(x);
+        left(x) = right(y);
+        if (right(y) != none) set_parent(right(y), x);
+        set_parent(y, parent(x));
+        replace_child(x, y);
+        right(y) = x;
+        set_parent(x, y);
+    }
+
+    void insert_fixup(uint32_t z) {
+        while (z != root && is_red(parent(z))) {
+            uint32_t p = parent(z);
+            uint32_t g = parent(p);
+            if (p == left(g)) {
+                uint32_t u = right(g);
+                if (is_red(u)) { // Красный дядя: перекраска и подъём
+                    set_red(p, false);
+                    set_red(u, false);
+                    set_red(g, true);
+                    z = g;
+                } else {
+                    if (z == right(p)) {
+                        z = p;
+                        left_rotate(z);
+                        p = parent(z);
+                    }
+                    set_red(p, false);
+                    set_red(g, true);
+                    right_rotate(g);
+                }
+            } else {
+                uint32_t u = left(g);
+                if (is_red(u)) {
+                    set_red(p, false);
+                    set_red(u, false);
+                    set_red(g, true);
+                    z = g;
+                } else {
+                    if (z == left(p)) {
+                        z = p;
+                        right_rotate(z);
+                        p = parent(z);
+                    }
+                    set_red(p, false);
+                    set_red(g, true);
+                    left_rotate(g);
+                }
+            }
+        }
+        set_red(root, false);
+    }
+
+    // Как tree::transplant, но для индексов
+    void transplant(uint32_t u, uint32_t v) {
+        replace_child(u, v);
+        if (v != none) set_parent(v, parent(u));
+    }
+
+    // x может отсутствовать, поэтому его родитель передаётся отдельно
+    void delete_fixup(uint32_t x, uint32_t xp) {
+        while (x != root && !is_red(x)) {
+            if (x == left(xp)) {
+                uint32_t w = right(xp);
+                if (is_red(w)) {
+                    set_red(w, false);
+                    set_red(xp, true);
+                    left_rotate(xp);
+                    w = right(xp);
+                }
+                if (!is_red(left(w)) && !is_red(right(w))) {
+                    set_red(w, true);
+                    x = xp;
+                    xp = parent(x);
+                } else {
+                    if (!is_red(right(w))) {
+                        set_red(left(w), false);
+                        set_red(w, true);
+                        right_rotate(w);
+                        w = right(xp);
+                    }
+                    set_red(w, is_red(xp));
+                    set_red(xp, false);
+                    set_red(right(w), false);
+                    left_rotate(xp);
+                    x = root;
+                }
+            } else {
+                uint32_t w = left(xp);
+                if (is_red(w)) {
+                    set_red(w, false);
+                    set_red(xp, true);
+                    right_rotate(xp);
+                    w = left(xp);
+                }
+                if (!is_red(right(w)) && !is_red(left(w))) {
+                    set_red(w, true);
+                    x = xp;
+                    xp = parent(x);
+                } else {
+                    if (!is_red(left(w))) {
+                        set_red(right(w), false);
+                        set_red(w, true);
+                        left_rotate(w);
+                        w = left(xp);
+                    }
+                    set_red(w, is_red(xp));
+                    set_red(xp, false);
+                    set_red(left(w), false);
+                    right_rotate(xp);
+                    x = root;
+                }
+            }
+        }
+        if (x != none) set_red(x, false);
+    }
+
+    uint32_t find(const T& value) const {
+        uint32_t x = root;
+        while (x != none) {
+            if (value < pool[x].data) x = left(x);
+            else if (pool[x].data < value) x = right(x);
+            else return x;
+        }
+        return none;
+    }
+
+    // Первый узел не меньше value (upper = false) или строго больше (upper = true)
+    uint32_t bound(const T& value, bool upper) const {
+        uint32_t result = none;
+        uint32_t x = root;
+        while (x != none) {
+            bool go_left = upper ? value < pool[x].data : !(pool[x].data < value);
+            if (go_left) {
+                result = x;
+                x = left(x);
+            } else {
+                x = right(x);
+            }
+        }
+        return result;
+    }
+
+public:
+    // Двунаправленный итератор: индекс узла и дерево
+    class iterator {
+    private:
+        uint32_t x;
+        const compact_tree* owner;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        iterator(uint32_t i, const compact_tree* t) : x(i), owner(t) {}
+
+        reference operator*() const { return owner->pool[x].data; }
+        pointer operator->() const { return &owner->pool[x].data; }
+
+        iterator& operator++() {
+            x = owner->successor(x);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        iterator& operator--() {
+            x = (x == none) ? owner->maximum(owner->root) : owner->predecessor(x);
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const { return x == other.x; }
+        bool operator!=(const iterator& other) const { return x != other.x; }
+    };
+
+    void insert(const T& value) {
+        uint32_t y = none;
+        uint32_t x = root;
+        while (x != none) {
+            y = x;
+            if (value < pool[x].data) x = left(x);
+            else if (pool[x].data < value) x = right(x);
+            else return; // Дубликаты не храним
+        }
+        uint32_t z = allocate(value, y); // pool мог переехать, дальше только индексы
+        if (y == none) root = z;
+        else if (value < pool[y].data) left(y) = z;
+        else right(y) = z;
+        ++count;
+        insert_fixup(z);
+    }
+
+    void erase(const T& value) {
+        uint32_t z = find(value);
+        if (z == none) return;
+        uint32_t y = z;
+        uint32_t x;
+        uint32_t xp;
+        bool y_red = is_red(y);
+        if (left(z) == none) {
+            x = right(z);
+            xp = parent(z);
+            transplant(z, x);
+        } else if (right(z) == none) {
+            x = left(z);
+            xp = parent(z);
+            transplant(z, x);
+        } else {
+            y = minimum(right(z)); // Преемник встаёт на место z
+            y_red = is_red(y);
+            x = right(y);
+            if (parent(y) == z) {
+                xp = y;
+            } else {
+                xp = parent(y);
+                transplant(y, x);
+                right(y) = right(z);
+                set_parent(right(y), y);
+            }
+            transplant(z, y);
+            left(y) = left(z);
+            set_parent(left(y), y);
+            set_red(y, is_red(z));
+        }
+        release(z);
+        --count;
+        if (!y_red) delete_fixup(x, xp);
+    }
+
+    bool contains(const T& value) const {
+        return find(value) != none;
+    }
+
+    bool empty() const {
+        return root == none;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Память отдаётся целиком, без обхода узлов
+    void clear() {
+        std::vector<cnode>().swap(pool);
+        free_head = none;
+        root = none;
+        count = 0;
+    }
+
+    iterator lower_bound(const T& value) const {
+        return iterator(bound(value, false), this);
+    }
+
+    iterator upper_bound(const T& value) const {
+        return iterator(bound(value, true), this);
+    }
+
+    // Размеров поддеревьев нет: спуск к lo и проход по диапазону, O(log n + k)
+    size_t count_range(const T& lo, const T& hi) const {
+        size_t result = 0;
+        for (uint32_t x = bound(lo, false); x != none && pool[x].data < hi; x = successor(x)) ++result;
+        return result;
+    }
+
+    iterator begin() const {
+        return iterator(minimum(root), this);
+    }
+
+    iterator end() const {
+        return iterator(none, this);
+    }
+};
+
+// Обёртка my_set; Tree - tree<T> (красно-чёрное), btree<T> или compact_tree<T>
+template <typename T, typename Tree = tree<T>>
 class my_set {
 private:
-    tree<T> rb_tree; // Используем внутреннее красно-чёрное дерево
+    Tree rb_tree; // Внутреннее дерево
 
 public:
+    using iterator = typename Tree::iterator;
+
     // Вставляет значение в множество
     void insert(const T& value) {
         rb_tree.insert(value);
@@ -344,14 +1761,56 @@ public:
         rb_tree.clear();
     }
 
-    // begin и end возвращают "итераторы" (в виде true/false)
-    // Это не полноценные итераторы STL, а упрощённая реализация
-    bool begin() const {
-        return rb_tree.begin_node() != nullptr; // true, если есть хотя бы один элемент
+    // Сколько элементов меньше value
+    size_t rank(const T& value) const {
+        return rb_tree.rank(value);
+    }
+
+    // Операции над множествами; other после вызова пуст (чтобы сохранить его, передайте копию)
+    void union_with(my_set& other) {
+        rb_tree.union_with(other.rb_tree);
+    }
+
+    void intersect_with(my_set& other) {
+        rb_tree.intersect_with(other.rb_tree);
+    }
+
+    void difference(my_set& other) {
+        rb_tree.difference(other.rb_tree);
+    }
+
+    // k-й по возрастанию элемент (k от 0)
+    const T& select(size_t k) const {
+        return rb_tree.select(k);
+    }
+
+    // Первый элемент не меньше value
+    iterator lower_bound(const T& value) const {
+        return rb_tree.lower_bound(value);
     }
 
-    bool end() const {
-        return false; // условный "конец"
+    // Первый элемент строго больше value
+    iterator upper_bound(const T& value) const {
+        return rb_tree.upper_bound(value);
+    }
+
+    // Элементы, равные value (не больше одного)
+    std::pair<iterator, iterator> equal_range(const T& value) const {
+        return {lower_bound(value), upper_bound(value)};
+    }
+
+    // Сколько элементов в [lo, hi) - за O(log n) по размерам поддеревьев
+    size_t count_range(const T& lo, const T& hi) const {
+        return rb_tree.count_range(lo, hi);
+    }
+
+    // Двунаправленные итераторы по возрастанию
+    iterator begin() const {
+        return rb_tree.begin();
+    }
+
+    iterator end() const {
+        return rb_tree.end();
     }
 };
 
@@ -369,9 +1828,39 @@ int main() {
     s.erase(10); // Удаляем 10
     std::cout << s.contains(10) << std::endl; // 10 больше нет
 
+    std::cout << s.rank(20) << std::endl;     // 1 - меньше 20 только 5
+    std::cout << s.select(1) << std::endl;    // 20 - второй по порядку
+    std::cout << s.count_range(0, 20) << std::endl;  // 1 - в [0, 20) только 5
+    std::cout << *s.lower_bound(6) << std::endl;     // 20 - первый не меньше 6
+    std::cout << *--s.end() << std::endl;            // 20 - максимальный
+
     s.clear(); // Очищаем множество
     std::cout << s.empty() << std::endl; // множество теперь пустое
 
+    my_set<int> odd, low; // Операции над множествами
+    for (int i = 1; i < 100; i += 2) odd.insert(i);
+    for (int i = 0; i < 50; ++i) low.insert(i);
+    my_set<int> both = odd;
+    my_set<int> low_copy = low;
+    both.intersect_with(low_copy);
+    std::cout << both.size() << std::endl;    // 25 - нечётные меньше 50
+    odd.union_with(low);
+    std::cout << odd.size() << std::endl;     // 75
+
+    my_set<int, btree<int>> b; // То же множество на B-дереве
+    for (int i = 0; i < 1000; ++i) b.insert(i * 2);
+    std::cout << b.size() << std::endl;       // 1000
+    std::cout << b.contains(998) << std::endl; // 998 есть
+    std::cout << b.rank(1000) << std::endl;   // 500 - столько чётных меньше 1000
+    std::cout << b.count_range(100, 200) << std::endl; // 50
+    std::cout << *b.upper_bound(100) << std::endl;     // 102
+
+    my_set<int, compact_tree<int>> c; // Компактные узлы по 16 байт
+    for (int i = 0; i < 1000; ++i) c.insert(i * 3);
+    for (int i = 0; i < 1000; i += 2) c.erase(i * 3);
+    std::cout << c.size() << std::endl;        // 500
+    std::cout << *c.lower_bound(10) << std::endl; // 15 - нечётные кратные 3 остались
+
     return 0;
 
 }
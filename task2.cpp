@@ -3,32 +3,506 @@
 #include <thread>      
 #include <cstddef> 
 #include <shared_mutex>
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <chrono>
+#include <optional>
+#include <tuple>
+#include <string>
+#include <memory>
 
-//тип Т
+//пул узлов: узлы нарезаются из непрерывных блоков (слэбов),
+//а освобождённые уходят в список свободных и переиспользуются
+template <typename N>
+class SlabPool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(N) unsigned char storage[sizeof(N)];
+    };
+
+    static constexpr std::size_t slab_nodes = 1024;
+
+    std::vector<Slot*> slabs;
+    Slot* free_list = nullptr;
+    std::size_t used = slab_nodes; //занято слотов в последнем слэбе
+
+public:
+    //все узлы можно отдать разом через release()
+    static constexpr bool bulk_release = true;
+
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    ~SlabPool() {
+        release();
+    }
+
+    template <typename... Args>
+    N* create(Args&&... args) {
+        Slot* slot;
+        if (free_list != nullptr) {
+            slot = free_list;
+            free_list = slot->next;
+        } else {
+            if (used == slab_nodes) {
+                slabs.push_back(new Slot[slab_nodes]);
+                used = 0;
+            }
+            slot = &slabs.back()[used++];
+        }
+        return new (slot->storage) N(std::forward<Args>(args)...);
+    }
+
+    void destroy(N* node) {
+        node->~N();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+    //освобождает все слэбы за O(слэбов), деструкторы узлов не вызываются
+    void release() {
+        for (Slot* slab : slabs) {
+            delete[] slab;
+        }
+        slabs.clear();
+        free_list = nullptr;
+        used = slab_nodes;
+    }
+};
+
+//обычный new/delete на каждый узел
+template <typename N>
+class HeapPool {
+public:
+    static constexpr bool bulk_release = false;
+
+    template <typename... Args>
+    N* create(Args&&... args) {
+        return new N(std::forward<Args>(args)...);
+    }
+
+    void destroy(N* node) {
+        delete node;
+    }
+
+    void release() {}
+};
+
+//читатели без блокировок: каждый отмечается счётчиком в своём слоте текущей фазы,
+//писатель переключает фазу и ждёт, пока уйдут все читатели, вошедшие до переключения
+class ReaderDomain {
+public:
+    static constexpr std::size_t slots = 64;
+
+private:
+    //слот на своей кэш-линии, чтобы читатели разных потоков не мешали друг другу
+    struct alignas(64) Slot {
+        std::atomic<std::size_t> active[2];
+    };
+
+    Slot counters[slots];
+    std::atomic<unsigned> phase{0};
+
+    static std::size_t my_slot() {
+        static thread_local std::size_t slot =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) % slots;
+        return slot;
+    }
+
+public:
+    class Guard {
+    private:
+        std::atomic<std::size_t>* counter;
+
+    public:
+        explicit Guard(ReaderDomain& domain)
+            : counter(&domain.counters[my_slot()].active[domain.phase.load()]) {
+            counter->fetch_add(1);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard() {
+            counter->fetch_sub(1);
+        }
+    };
+
+    ReaderDomain() {
+        for (Slot& slot : counters) {
+            slot.active[0].store(0);
+            slot.active[1].store(0);
+        }
+    }
+
+    //круг ожидания по частям: flip переключает фазу и возвращает старую,
+    //drained говорит, ушли ли читатели старой фазы. Круги начинает один поток за раз
+    unsigned flip() {
+        unsigned old = phase.load();
+        phase.store(old ^ 1);
+        return old;
+    }
+
+    bool drained(unsigned old) const {
+        for (const Slot& slot : counters) {
+            if (slot.active[old].load() != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //ждёт всех читателей, начавших чтение до вызова; два круга покрывают обе фазы
+    void synchronize() {
+        for (int round = 0; round < 2; ++round) {
+            unsigned old = flip();
+            while (!drained(old)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+//аллокатор для vector с выравниванием по кэш-линии
+template <typename T>
+struct CacheAlignedAllocator {
+    using value_type = T;
+
+    CacheAlignedAllocator() = default;
+
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(64)));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(64));
+    }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+//неизменяемый снимок множества: ключи лежат в одном массиве в порядке Эйтцингера
+//(обход дерева в ширину, потомки k - это 2k и 2k + 1, нумерация с 1).
+//Спуск без ветвлений: сравнение только выбирает следующий индекс, а узлы
+//на несколько уровней ниже заранее подгружаются в кэш
 template <typename T>
-class Set {
+class FrozenSet {
+private:
+    //сколько ключей в одной кэш-линии: потомки k через log2(per_line) уровней
+    //лежат подряд, начиная с k * per_line, и загружаются одной подгрузкой
+    static constexpr std::size_t per_line = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+
+    std::vector<T, CacheAlignedAllocator<T>> keys; //keys[0] не используется
+    std::size_t n = 0;
+
+    //раскладывает sorted по позициям поддерева с корнем k
+    void fill(const std::vector<T>& sorted, std::size_t& next, std::size_t k) {
+        if (k > n) return;
+        fill(sorted, next, 2 * k);
+        keys[k] = sorted[next++];
+        fill(sorted, next, 2 * k + 1);
+    }
+
+    //позиция первого ключа не меньше value, 0 - если такого нет
+    template <typename K>
+    std::size_t lower_index(const K& value) const {
+        const T* b = keys.data();
+        std::size_t k = 1;
+        while (k <= n) {
+            __builtin_prefetch(b + std::min(k * per_line, n));
+            k = 2 * k + (b[k] < value);
+        }
+        //спуск закончился за листом: снимаем хвост из правых шагов и ещё один левый
+        return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+    }
+
+public:
+    FrozenSet() = default;
+
+    //sorted - ключи по возрастанию без повторов
+    explicit FrozenSet(const std::vector<T>& sorted) : keys(sorted.size() + 1), n(sorted.size()) {
+        std::size_t next = 0;
+        fill(sorted, next, 1);
+    }
+
+    template <typename K>
+    bool contains(const K& value) const {
+        std::size_t k = lower_index(value);
+        return k != 0 && !(value < keys[k]);
+    }
+
+    //первый ключ не меньше value или nullptr
+    template <typename K>
+    const T* lower_bound(const K& value) const {
+        std::size_t k = lower_index(value);
+        return k != 0 ? &keys[k] : nullptr;
+    }
+
+    std::size_t size() const {
+        return n;
+    }
+
+    bool empty() const {
+        return n == 0;
+    }
+};
+
+//счётчики выключены: все вызовы пустые и исчезают при компиляции
+struct NoStats {
+    static constexpr bool enabled = false;
+
+    struct Totals {};
+
+    void shared_wait(std::uint64_t) {}
+    void unique_wait(std::uint64_t) {}
+    void rotation() {}
+    void recolor(unsigned) {}
+    void inserted(std::uint64_t) {}
+    void erased() {}
+    void node_allocation() {}
+    void index_allocation() {}
+
+    Totals read() const {
+        return {};
+    }
+};
+
+//счётчики горячего пути: каждый поток пишет в свой слот на отдельной кэш-линии
+//(как в ReaderDomain), суммы собираются только при чтении
+class SetStats {
+public:
+    static constexpr bool enabled = true;
+    static constexpr std::size_t slots = 64;
+
+    struct Totals {
+        std::uint64_t shared_locks = 0;
+        std::uint64_t shared_wait_ns = 0;
+        std::uint64_t unique_locks = 0;
+        std::uint64_t unique_wait_ns = 0;
+        std::uint64_t inserts = 0;
+        std::uint64_t erases = 0;
+        std::uint64_t rotations = 0;
+        std::uint64_t recolors = 0;
+        std::uint64_t node_allocations = 0;  //узлы дерева
+        std::uint64_t index_allocations = 0; //копии узлов индекса для чтения
+        std::uint64_t descent_sum = 0;       //шагов спуска при вставках
+        std::uint64_t descent_max = 0;
+
+        //среднее на одну вставку или удаление
+        double per_op(std::uint64_t value) const {
+            std::uint64_t ops = inserts + erases;
+            return ops == 0 ? 0.0 : static_cast<double>(value) / ops;
+        }
+    };
+
 private:
+    enum Counter {
+        SHARED_LOCKS, SHARED_WAIT_NS, UNIQUE_LOCKS, UNIQUE_WAIT_NS, INSERTS, ERASES,
+        ROTATIONS, RECOLORS, NODE_ALLOCATIONS, INDEX_ALLOCATIONS, DESCENT_SUM, DESCENT_MAX, COUNTERS
+    };
+
+    //поток почти всегда один в слоте, поэтому хватает relaxed-операций без общей линии
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> values[COUNTERS];
+    };
+
+    Slot counters[slots];
+
+    static std::size_t my_slot() {
+        static thread_local std::size_t slot =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) % slots;
+        return slot;
+    }
+
+    void add(Counter counter, std::uint64_t value) {
+        counters[my_slot()].values[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+public:
+    SetStats() {
+        for (Slot& slot : counters) {
+            for (std::atomic<std::uint64_t>& value : slot.values) {
+                value.store(0);
+            }
+        }
+    }
+
+    void shared_wait(std::uint64_t ns) {
+        add(SHARED_LOCKS, 1);
+        add(SHARED_WAIT_NS, ns);
+    }
+
+    void unique_wait(std::uint64_t ns) {
+        add(UNIQUE_LOCKS, 1);
+        add(UNIQUE_WAIT_NS, ns);
+    }
+
+    void rotation() {
+        add(ROTATIONS, 1);
+    }
+
+    void recolor(unsigned nodes) {
+        add(RECOLORS, nodes);
+    }
+
+    void inserted(std::uint64_t descent) {
+        add(INSERTS, 1);
+        add(DESCENT_SUM, descent);
+        std::atomic<std::uint64_t>& max = counters[my_slot()].values[DESCENT_MAX];
+        if (descent > max.load(std::memory_order_relaxed)) {
+            max.store(descent, std::memory_order_relaxed);
+        }
+    }
+
+    void erased() {
+        add(ERASES, 1);
+    }
+
+    void node_allocation() {
+        add(NODE_ALLOCATIONS, 1);
+    }
+
+    void index_allocation() {
+        add(INDEX_ALLOCATIONS, 1);
+    }
+
+    Totals read() const {
+        std::uint64_t sum[COUNTERS] = {};
+        for (const Slot& slot : counters) {
+            for (int i = 0; i < COUNTERS; ++i) {
+                std::uint64_t value = slot.values[i].load(std::memory_order_relaxed);
+                sum[i] = (i == DESCENT_MAX) ? std::max(sum[i], value) : sum[i] + value;
+            }
+        }
+        Totals totals;
+        totals.shared_locks = sum[SHARED_LOCKS];
+        totals.shared_wait_ns = sum[SHARED_WAIT_NS];
+        totals.unique_locks = sum[UNIQUE_LOCKS];
+        totals.unique_wait_ns = sum[UNIQUE_WAIT_NS];
+        totals.inserts = sum[INSERTS];
+        totals.erases = sum[ERASES];
+        totals.rotations = sum[ROTATIONS];
+        totals.recolors = sum[RECOLORS];
+        totals.node_allocations = sum[NODE_ALLOCATIONS];
+        totals.index_allocations = sum[INDEX_ALLOCATIONS];
+        totals.descent_sum = sum[DESCENT_SUM];
+        totals.descent_max = sum[DESCENT_MAX];
+        return totals;
+    }
+};
+
+//ключ элемента множества - сам элемент
+struct IdentityKey {
+    template <typename V>
+    const V& operator()(const V& value) const {
+        return value;
+    }
+};
+
+//ключ элемента словаря - first у пары
+struct PairKey {
+    template <typename P>
+    const typename P::first_type& operator()(const P& pair) const {
+        return pair.first;
+    }
+};
+
+//общее красно-чёрное дерево для Set и Map: узлы, блокировка, повороты и балансировка.
+//Value - что лежит в узле, KeyOf достаёт из него ключ для сравнений
+template <typename Value, typename KeyOf, template <typename> class Pool, typename Stats>
+class RBTree {
+protected:
     //состояния для цвета
     enum Color { RED, BLACK };
     
     // узел
     struct Node {
-        T data;
+        Value data;
         Node* parent;
         Node* left;
         Node* right;
         Color color;
 
-        //конструктор узла с заданным значением
-        Node(const T& d) 
-            : data(d), parent(nullptr), left(nullptr), right(nullptr), color(RED) {}
+        //значение собирается прямо в узле из аргументов
+        template <typename... Args>
+        explicit Node(Args&&... args)
+            : data(std::forward<Args>(args)...), parent(nullptr), left(nullptr), right(nullptr), color(RED) {}
     };
 
     Node* root; //корень
     Node* nil;  //ноль
+    Pool<Node> pool;
     mutable std::shared_mutex mtx;
+    mutable Stats counters;
+
+    static const auto& key_of(const Node* node) {
+        return KeyOf()(node->data);
+    }
+
+    RBTree() {
+        nil = new Node();
+        nil->color = BLACK;
+        nil->parent = nil->left = nil->right = nil;
+        root = nil;
+    }
+
+    RBTree(const RBTree&) = delete;
+    RBTree& operator=(const RBTree&) = delete;
+
+    ~RBTree() {
+        destroy_nodes();
+        delete nil;
+    }
+
+    //захват блокировок; со SetStats замеряется время ожидания
+    std::unique_lock<std::shared_mutex> lock_unique() const {
+        if constexpr (Stats::enabled) {
+            auto start = std::chrono::steady_clock::now();
+            std::unique_lock<std::shared_mutex> lock(mtx);
+            counters.unique_wait(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            return lock;
+        } else {
+            return std::unique_lock<std::shared_mutex>(mtx);
+        }
+    }
+
+    std::shared_lock<std::shared_mutex> lock_shared() const {
+        if constexpr (Stats::enabled) {
+            auto start = std::chrono::steady_clock::now();
+            std::shared_lock<std::shared_mutex> lock(mtx);
+            counters.shared_wait(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            return lock;
+        } else {
+            return std::shared_lock<std::shared_mutex>(mtx);
+        }
+    }
+
+    std::size_t height(Node* node) const {
+        if (node == nil) return 0;
+        return 1 + std::max(height(node->left), height(node->right));
+    }
 
     void left_rotate(Node* x) {
+        counters.rotation();
         Node* y = x->right;
         x->right = y->left;
         
@@ -51,6 +525,7 @@ private:
     }
 
     void right_rotate(Node* x) {
+        counters.rotation();
         Node* y = x->left;
         x->left = y->right;
         
@@ -79,6 +554,7 @@ private:
                 Node* uncle = k->parent->parent->right;
                 
                 if (uncle->color == RED) {
+                    counters.recolor(3);
                     k->parent->color = BLACK;
                     uncle->color = BLACK;
                     k->parent->parent->color = RED;
@@ -89,6 +565,7 @@ private:
                         left_rotate(k);
                     }
                     
+                    counters.recolor(2);
                     k->parent->color = BLACK;
                     k->parent->parent->color = RED;
                     right_rotate(k->parent->parent);
@@ -97,6 +574,7 @@ private:
                 Node* uncle = k->parent->parent->left;
                 
                 if (uncle->color == RED) {
+                    counters.recolor(3);
                     k->parent->color = BLACK;
                     uncle->color = BLACK;
                     k->parent->parent->color = RED;
@@ -107,6 +585,7 @@ private:
                         right_rotate(k);
                     }
                     
+                    counters.recolor(2);
                     k->parent->color = BLACK;
                     k->parent->parent->color = RED;
                     left_rotate(k->parent->parent);
@@ -123,19 +602,46 @@ private:
         return node;
     }
 
+    Node* maximum(Node* node) const {
+        while (node->right != nil) {
+            node = node->right;
+        }
+        return node;
+    }
+
+    //обход без рекурсии: левый потомок поворотом поднимается наверх,
+    //узел без левого потомка освобождается, и обход идёт вправо
     void clear(Node* node) {
-        if (node == nil) return;
-        clear(node->left);
-        clear(node->right);
-        delete node;
+        while (node != nil) {
+            if (node->left != nil) {
+                Node* left = node->left;
+                node->left = left->right;
+                left->right = node;
+                node = left;
+            } else {
+                Node* right = node->right;
+                pool.destroy(node);
+                node = right;
+            }
+        }
     }
 
-    Node* find_node(const T& value) const {
-        Node* current = root;
+    //удаление всех узлов: если деструкторы не нужны, слэбы отдаются целиком без обхода
+    void destroy_nodes() {
+        if (!Pool<Node>::bulk_release || !std::is_trivially_destructible<Value>::value) {
+            clear(root);
+        }
+        pool.release();
+        root = nil;
+    }
+
+    //поиск в поддереве current; ключ может быть любого типа, сравнимого с ключом Value
+    template <typename K>
+    Node* find_from(Node* current, const K& key) const {
         while (current != nil) {
-            if (value < current->data) {
+            if (key < key_of(current)) {
                 current = current->left;
-            } else if (current->data < value) {
+            } else if (key_of(current) < key) {
                 current = current->right;
             } else {
                 return current;
@@ -144,6 +650,123 @@ private:
         return nil;
     }
 
+    //первый узел с ключом не меньше key (upper = false) или строго больше (upper = true)
+    template <typename K>
+    Node* bound_node(const K& key, bool upper) const {
+        Node* result = nil;
+        Node* current = root;
+        while (current != nil) {
+            bool go_left = upper ? key < key_of(current) : !(key_of(current) < key);
+            if (go_left) {
+                result = current;
+                current = current->left;
+            } else {
+                current = current->right;
+            }
+        }
+        return result;
+    }
+
+    //вставка со спуском от start; узел собирается из args, только если key ещё нет.
+    //Возвращает узел с key и true, если он новый
+    template <typename K, typename... Args>
+    std::pair<Node*, bool> insert_from(Node* start, const K& key, Args&&... args) {
+        Node* y = nil;
+        Node* x = start;
+        std::uint64_t descent = 0;
+        
+        //поиск места
+        while (x != nil) {
+            y = x;
+            ++descent;
+            if (key < key_of(x)) {
+                x = x->left;
+            } else if (key_of(x) < key) {
+                x = x->right;
+            } else {
+                return {x, false};
+            }
+        }
+
+        //сторона выбирается до того, как key может быть перемещён в узел вместе со значением
+        bool as_left = y != nil && key < key_of(y);
+
+        //новый узел
+        counters.node_allocation();
+        counters.inserted(descent);
+        Node* new_node = pool.create(std::forward<Args>(args)...);
+        new_node->parent = y;
+        new_node->left = nil;
+        new_node->right = nil;
+        new_node->color = RED;
+
+        //привязка узла
+        if (y == nil) {
+            root = new_node;
+        } else if (as_left) {
+            y->left = new_node;
+        } else {
+            y->right = new_node;
+        }
+
+        fix_insert(new_node);
+        return {new_node, true};
+    }
+
+    //с чего начинать вставку по подсказке: если key встаёт сразу перед hint,
+    //у hint или у его предшественника есть свободное место ровно под key
+    template <typename K>
+    Node* hint_start(Node* hint, const K& key) const {
+        Node* before = (hint == nil) ? maximum(root) : predecessor(hint);
+        bool fits = (hint == nil || key < key_of(hint)) && (before == nil || key_of(before) < key);
+        if (!fits) {
+            return root;
+        }
+        return (hint != nil && hint->left == nil) ? hint : before;
+    }
+
+    Node* successor(Node* node) const {
+        if (node->right != nil) {
+            return minimum(node->right);
+        }
+        Node* parent = node->parent;
+        while (parent != nil && node == parent->right) {
+            node = parent;
+            parent = parent->parent;
+        }
+        return parent;
+    }
+
+    Node* predecessor(Node* node) const {
+        if (node->left != nil) {
+            node = node->left;
+            while (node->right != nil) {
+                node = node->right;
+            }
+            return node;
+        }
+        Node* parent = node->parent;
+        while (parent != nil && node == parent->left) {
+            node = parent;
+            parent = parent->parent;
+        }
+        return parent;
+    }
+
+    //палец - узел с ключом меньше key; поднимаемся до предка,
+    //в поддереве которого key может лежать, и ищем уже оттуда
+    template <typename K>
+    Node* finger_start(Node* finger, const K& key) const {
+        if (finger == nil) return root;
+        Node* x = finger;
+        while (x != root) {
+            Node* p = x->parent;
+            if (x == p->left && key < key_of(p)) break;
+            x = p;
+        }
+        return x;
+    }
+
     void transplant(Node* u, Node* v) {
         if (u->parent == nil) {
             root = v;
@@ -187,7 +810,8 @@ private:
         if (y_original_color == BLACK) {
             fix_delete(x);
         }
-        delete z;
+        pool.destroy(z);
+        counters.erased();
     }
 
     void fix_delete(Node* x) {
@@ -195,21 +819,25 @@ private:
             if (x == x->parent->left) {
                 Node* w = x->parent->right;
                 if (w->color == RED) {
+                    counters.recolor(2);
                     w->color = BLACK;
                     x->parent->color = RED;
                     left_rotate(x->parent);
                     w = x->parent->right;
                 }
                 if (w->left->color == BLACK && w->right->color == BLACK) {
+                    counters.recolor(1);
                     w->color = RED;
                     x = x->parent;
                 } else {
                     if (w->right->color == BLACK) {
+                        counters.recolor(2);
                         w->left->color = BLACK;
                         w->color = RED;
                         right_rotate(w);
                         w = x->parent->right;
                     }
+                    counters.recolor(3);
                     w->color = x->parent->color;
                     x->parent->color = BLACK;
                     w->right->color = BLACK;
@@ -219,21 +847,25 @@ private:
             } else {
                 Node* w = x->parent->left;
                 if (w->color == RED) {
+                    counters.recolor(2);
                     w->color = BLACK;
                     x->parent->color = RED;
                     right_rotate(x->parent);
                     w = x->parent->left;
                 }
                 if (w->right->color == BLACK && w->left->color == BLACK) {
+                    counters.recolor(1);
                     w->color = RED;
                     x = x->parent;
                 } else {
                     if (w->left->color == BLACK) {
+                        counters.recolor(2);
                         w->right->color = BLACK;
                         w->color = RED;
                         left_rotate(w);
                         w = x->parent->left;
                     }
+                    counters.recolor(3);
                     w->color = x->parent->color;
                     x->parent->color = BLACK;
                     w->left->color = BLACK;
@@ -244,24 +876,267 @@ private:
         }
         x->color = BLACK;
     }
+};
 
+//тип Т, Pool - откуда брать узлы, Stats - NoStats или SetStats для замеров
+template <typename T, template <typename> class Pool = SlabPool, typename Stats = NoStats>
+class Set : private RBTree<T, IdentityKey, Pool, Stats> {
+private:
+    using Core = RBTree<T, IdentityKey, Pool, Stats>;
+    using typename Core::Node;
+    using Core::root;
+    using Core::nil;
+    using Core::counters;
+    using Core::lock_unique;
+    using Core::lock_shared;
+    using Core::minimum;
+    using Core::maximum;
+    using Core::successor;
+    using Core::predecessor;
+    using Core::find_from;
+    using Core::bound_node;
+    using Core::insert_from;
+    using Core::hint_start;
+    using Core::finger_start;
+    using Core::delete_node;
+    using Core::destroy_nodes;
 
-public:
-    //итераторы
-    class Iterator {
-    private:
-        Node* node;
-        Node* nil;
-        std::shared_mutex* mtx;
+    //узел индекса для чтения: неизменяемый после публикации,
+    //писатели копируют путь от корня до изменённого места (декартово дерево).
+    //Версии делят общие поддеревья, refs - сколько родителей и корней версий на узел ссылаются
+    struct ReadNode {
+        T data;
+        ReadNode* left;
+        ReadNode* right;
+        unsigned priority;
+        std::atomic<std::size_t> refs;
 
-    public:
-        using iterator_category = std::bidirectional_iterator_tag;
-        using value_type = T;
-        using difference_type = std::ptrdiff_t;
-        using pointer = const T*;
-        using reference = const T&;
+        ReadNode(const T& d, unsigned p)
+            : data(d), left(nullptr), right(nullptr), priority(p), refs(1) {}
+    };
+
+    //сколько заменённых версий индекса копить перед ожиданием читателей
+    static constexpr std::size_t retire_batch = 64;
+
+    std::atomic<ReadNode*> read_root{nullptr}; //текущая версия индекса для contains
+    Pool<ReadNode> read_pool;
+    std::vector<ReadNode*> retired; //корни старых версий, ждущие ухода читателей
+    std::vector<ReadNode*> pending; //пачка, ждущая двух кругов ReaderDomain
+    unsigned pending_phase = 0; //фаза, читателей которой ждёт текущий круг
+    int pending_rounds = 0;
+    mutable std::atomic<std::size_t> snapshots{0}; //живые Snapshot
+    mutable std::mutex orphan_mtx;
+    mutable std::vector<ReadNode*> orphans; //корни, отпущенные последним снимком; освобождает писатель
+    unsigned seed = 2463534242u;
+    mutable ReaderDomain readers;
+
+    //удаление дерева и индекса; узлы индекса, как и узлы дерева, без нужды не обходятся
+    void destroy_all() {
+        bool walk = !Pool<ReadNode>::bulk_release || !std::is_trivially_destructible<T>::value;
+        destroy_nodes();
+
+        //узлы индекса, на которые ссылаются снимки, должны пережить clear
+        ReadNode* old = read_root.exchange(nullptr);
+        readers.synchronize();
+        bool pinned = snapshots.load() != 0;
+        if (walk || pinned) {
+            index_release(old);
+            for (ReadNode* node : retired) {
+                index_release(node);
+            }
+            for (ReadNode* node : pending) {
+                index_release(node);
+            }
+            release_orphans();
+        } else {
+            std::lock_guard<std::mutex> lock(orphan_mtx);
+            orphans.clear();
+        }
+        retired.clear();
+        pending.clear();
+        pending_rounds = 0;
+        if (!pinned) {
+            read_pool.release();
+        }
+    }
+
+    static ReadNode* index_acquire(ReadNode* node) {
+        if (node != nullptr) {
+            node->refs.fetch_add(1);
+        }
+        return node;
+    }
+
+    //снимает ссылку; узел без ссылок освобождается и отпускает своих потомков
+    void index_release(ReadNode* node) {
+        if (node != nullptr && node->refs.fetch_sub(1) == 1) {
+            index_free(node);
+        }
+    }
+
+    void index_free(ReadNode* node) {
+        index_release(node->left);
+        index_release(node->right);
+        read_pool.destroy(node);
+    }
+
+    //пул не потокобезопасен, поэтому корни от снимков освобождаются здесь, под блокировкой писателя
+    void release_orphans() {
+        std::vector<ReadNode*> nodes;
+        {
+            std::lock_guard<std::mutex> lock(orphan_mtx);
+            nodes.swap(orphans);
+        }
+        for (ReadNode* node : nodes) {
+            index_free(node);
+        }
+    }
+
+    unsigned next_priority() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
 
-        Iterator(Node* n, Node* nil_node, std::shared_mutex* m) : node(n), nil(nil_node), mtx(m) {}
+    //копия узла без потомков; ссылку на копию держит вызывающий
+    ReadNode* index_copy(const ReadNode* node) {
+        counters.index_allocation();
+        return read_pool.create(node->data, node->priority);
+    }
+
+    //функции изменения индекса не трогают ссылки на t и возвращают корень новой версии
+    //со своей ссылкой; нетронутые поддеревья t становятся общими.
+    //Вставка: value там ещё нет, новые узлы можно менять до публикации
+    ReadNode* index_insert(ReadNode* t, const T& value) {
+        if (t == nullptr) {
+            counters.index_allocation();
+            return read_pool.create(value, next_priority());
+        }
+        ReadNode* n = index_copy(t);
+        if (value < t->data) {
+            ReadNode* l = index_insert(t->left, value);
+            n->left = l;
+            n->right = index_acquire(t->right);
+            if (l->priority > n->priority) {
+                n->left = l->right;
+                l->right = n;
+                return l;
+            }
+            return n;
+        }
+        ReadNode* r = index_insert(t->right, value);
+        n->left = index_acquire(t->left);
+        n->right = r;
+        if (r->priority > n->priority) {
+            n->right = r->left;
+            r->left = n;
+            return r;
+        }
+        return n;
+    }
+
+    ReadNode* index_merge(ReadNode* a, ReadNode* b) {
+        if (a == nullptr) return index_acquire(b);
+        if (b == nullptr) return index_acquire(a);
+        if (a->priority > b->priority) {
+            ReadNode* n = index_copy(a);
+            n->left = index_acquire(a->left);
+            n->right = index_merge(a->right, b);
+            return n;
+        }
+        ReadNode* n = index_copy(b);
+        n->left = index_merge(a, b->left);
+        n->right = index_acquire(b->right);
+        return n;
+    }
+
+    //удаление из индекса; value там точно есть
+    ReadNode* index_erase(ReadNode* t, const T& value) {
+        if (value < t->data) {
+            ReadNode* n = index_copy(t);
+            n->left = index_erase(t->left, value);
+            n->right = index_acquire(t->right);
+            return n;
+        }
+        if (t->data < value) {
+            ReadNode* n = index_copy(t);
+            n->left = index_acquire(t->left);
+            n->right = index_erase(t->right, value);
+            return n;
+        }
+        return index_merge(t->left, t->right);
+    }
+
+    //публикация новой версии (со ссылкой от вызывающего); ссылки старых версий
+    //снимаются пачками после ухода читателей, узлы из снимков при этом остаются жить.
+    //Как в ConcurrentSet::retire, круги ожидания идут по шагу на публикацию,
+    //и писатель под unique_lock не ждёт читателей
+    void publish(ReadNode* new_root) {
+        ReadNode* old = read_root.exchange(new_root);
+        if (old != nullptr) {
+            retired.push_back(old);
+        }
+        if (pending.empty()) {
+            if (retired.size() >= retire_batch) {
+                pending.swap(retired);
+                pending_phase = readers.flip();
+                pending_rounds = 0;
+            }
+            return;
+        }
+        if (!readers.drained(pending_phase)) {
+            return;
+        }
+        if (++pending_rounds < 2) {
+            pending_phase = readers.flip();
+            return;
+        }
+        for (ReadNode* node : pending) {
+            index_release(node);
+        }
+        pending.clear();
+        release_orphans();
+    }
+
+    //вставка под блокировкой и публикация в индекс для чтения
+    template <typename U>
+    std::pair<Node*, bool> insert_locked(Node* start, U&& value) {
+        std::pair<Node*, bool> result = insert_from(start, value, std::forward<U>(value));
+        if (result.second) {
+            publish(index_insert(read_root.load(), result.first->data));
+        }
+        return result;
+    }
+
+    template <typename It>
+    static std::vector<T> sorted_batch(It first, It last) {
+        std::vector<T> values(first, last);
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end(),
+                                 [](const T& a, const T& b) { return !(a < b) && !(b < a); }),
+                     values.end());
+        return values;
+    }
+
+
+public:
+    //итераторы
+    class Iterator {
+    private:
+        Node* node;
+        const Set* set;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        friend class Set;
+
+        Iterator(Node* n, const Set* s) : node(n), set(s) {}
 
         reference operator*() const { 
             return node->data; 
@@ -272,30 +1147,30 @@ public:
         }
 
         Iterator& operator++() {
-            std::shared_lock<std::shared_mutex> lock(*mtx);
-            if (node->right != nil) {
-                node = node->right;
-                while (node->left != nil) {
-                    node = node->left;
-                }
-            } else {
-                Node* parent = node->parent;
-                while (parent != nil && node == parent->right) {
-                    node = parent;
-                    parent = parent->parent;
-                }
-                node = parent;
-            }
+            std::shared_lock<std::shared_mutex> lock = set->lock_shared();
+            node = set->successor(node);
             return *this;
         }
 
         Iterator operator++(int) {
-            std::shared_lock<std::shared_mutex> lock(mtx);
             Iterator tmp = *this;
             ++(*this);
             return tmp;
         }
 
+        //шаг назад от end() попадает на максимальный элемент
+        Iterator& operator--() {
+            std::shared_lock<std::shared_mutex> lock = set->lock_shared();
+            node = (node == set->nil) ? set->maximum(set->root) : set->predecessor(node);
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            Iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
         bool operator==(const Iterator& other) const {
             return node == other.node;
         }
@@ -305,85 +1180,788 @@ public:
         }
     };
 
-    Set() {
-        nil = new Node(T());
-        nil->color = BLACK;
-        nil->parent = nil->left = nil->right = nil;
-        root = nil;
-    }
+    //неизменяемая версия множества: держит ссылку на корень индекса, поэтому обход
+    //идёт без блокировок, видит согласованное состояние и не мешает писателям.
+    //Снимок не должен пережить своё множество
+    class Snapshot {
+    private:
+        const Set* set = nullptr;
+        ReadNode* root = nullptr;
+
+        friend class Set;
+
+        Snapshot(const Set* s, ReadNode* r) : set(s), root(r) {}
+
+        void reset() {
+            if (set == nullptr) return;
+            if (root != nullptr && root->refs.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(set->orphan_mtx);
+                set->orphans.push_back(root);
+            }
+            set->snapshots.fetch_sub(1);
+            set = nullptr;
+            root = nullptr;
+        }
+
+    public:
+        //обход по возрастанию со стеком пути, у узлов индекса нет ссылок на родителя
+        class Iterator {
+        private:
+            std::vector<const ReadNode*> path;
+
+            void push_left(const ReadNode* node) {
+                for (; node != nullptr; node = node->left) {
+                    path.push_back(node);
+                }
+            }
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            explicit Iterator(const ReadNode* root = nullptr) {
+                push_left(root);
+            }
+
+            reference operator*() const {
+                return path.back()->data;
+            }
+
+            pointer operator->() const {
+                return &path.back()->data;
+            }
+
+            Iterator& operator++() {
+                const ReadNode* node = path.back();
+                path.pop_back();
+                push_left(node->right);
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator tmp = *this;
+                ++(*this);
+                return tmp;
+            }
+
+            bool operator==(const Iterator& other) const {
+                if (path.empty() || other.path.empty()) {
+                    return path.empty() == other.path.empty();
+                }
+                return path.back() == other.path.back();
+            }
+
+            bool operator!=(const Iterator& other) const {
+                return !(*this == other);
+            }
+        };
+
+        Snapshot(const Snapshot& other) : set(other.set), root(index_acquire(other.root)) {
+            if (set != nullptr) {
+                set->snapshots.fetch_add(1);
+            }
+        }
+
+        Snapshot(Snapshot&& other) noexcept : set(other.set), root(other.root) {
+            other.set = nullptr;
+            other.root = nullptr;
+        }
+
+        Snapshot& operator=(Snapshot other) {
+            std::swap(set, other.set);
+            std::swap(root, other.root);
+            return *this;
+        }
+
+        ~Snapshot() {
+            reset();
+        }
+
+        template <typename K>
+        bool contains(const K& value) const {
+            const ReadNode* current = root;
+            while (current != nullptr) {
+                if (value < current->data) {
+                    current = current->left;
+                } else if (current->data < value) {
+                    current = current->right;
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool empty() const {
+            return root == nullptr;
+        }
+
+        Iterator begin() const {
+            return Iterator(root);
+        }
+
+        Iterator end() const {
+            return Iterator();
+        }
+    };
+
+    Set() = default;
 
     ~Set() {
-        clear(root);
-        delete nil;
+        destroy_all();
     }
 
     void insert(const T& value) {
-        std::unique_lock<std::shared_mutex> lock(mtx);
-        Node* y = nil;
-        Node* x = root;
-        
-        //поиск места
-        while (x != nil) {
-            y = x;
-            if (value < x->data) {
-                x = x->left;
-            } else if (x->data < value) {
-                x = x->right;
-            } else {
-                return;
-            }
-        }
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        insert_locked(root, value);
+    }
 
-        //новый узел
-        Node* new_node = new Node(value);
-        new_node->parent = y;
-        new_node->left = nil;
-        new_node->right = nil;
-        new_node->color = RED;
+    void insert(T&& value) {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        insert_locked(root, std::move(value));
+    }
 
-        //привязка узла
-        if (y == nil) {
-            root = new_node;
-        } else if (value < y->data) {
-            y->left = new_node;
-        } else {
-            y->right = new_node;
+    //значение собирается из аргументов до блокировки; true, если оно новое
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        T value(std::forward<Args>(args)...);
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        return insert_locked(root, std::move(value)).second;
+    }
+
+    //вставка перед подсказкой hint: если она верна, спуска от корня нет
+    template <typename... Args>
+    Iterator emplace_hint(Iterator hint, Args&&... args) {
+        T value(std::forward<Args>(args)...);
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        Node* node = insert_locked(hint_start(hint.node, value), std::move(value)).first;
+        return Iterator(node, this);
+    }
+
+    //вставка пачки под одной блокировкой: ключи сортируются,
+    //и поиск места для каждого начинается от предыдущего вставленного узла
+    template <typename It>
+    void insert_batch(It first, It last) {
+        std::vector<T> values = sorted_batch(first, last);
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        ReadNode* index = index_acquire(read_root.load());
+        Node* finger = nil;
+        for (const T& value : values) {
+            std::pair<Node*, bool> result = insert_from(finger_start(finger, value), value, value);
+            finger = result.first;
+            if (result.second) {
+                //промежуточные версии никто не видел, их узлы освобождаются сразу
+                ReadNode* next = index_insert(index, value);
+                index_release(index);
+                index = next;
+            }
         }
+        publish(index);
+    }
 
-        fix_insert(new_node);
+    //удаление пачки под одной блокировкой, палец - предшественник удалённого узла
+    template <typename It>
+    void erase_batch(It first, It last) {
+        std::vector<T> values = sorted_batch(first, last);
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        ReadNode* index = index_acquire(read_root.load());
+        Node* finger = nil;
+        for (const T& value : values) {
+            Node* z = find_from(finger_start(finger, value), value);
+            if (z != nil) {
+                finger = predecessor(z);
+                delete_node(z);
+                ReadNode* next = index_erase(index, value);
+                index_release(index);
+                index = next;
+            }
+        }
+        publish(index);
     }
 
+
     void erase(const T& value) {
-        std::unique_lock<std::shared_mutex> lock(mtx);
-        Node* z = find_node(value);
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        Node* z = find_from(root, value);
         if (z != nil) {
             delete_node(z);
+            publish(index_erase(read_root.load(), value));
+        }
+    }
+
+    //без блокировки: читает опубликованную версию индекса;
+    //ключ может быть любого типа, сравнимого с T (например, string_view для строк)
+    template <typename K>
+    bool contains(const K& value) const {
+        ReaderDomain::Guard guard(readers);
+        const ReadNode* current = read_root.load();
+        while (current != nullptr) {
+            if (value < current->data) {
+                current = current->left;
+            } else if (current->data < value) {
+                current = current->right;
+            } else {
+                return true;
+            }
         }
+        return false;
     }
 
-    bool contains(const T& value) const {
-        std::shared_lock<std::shared_mutex> lock(mtx);
-        return find_node(value) != nil;
+    //поиск границ за O(log n) под shared_lock; ключ может быть любого типа, сравнимого с T
+    template <typename K>
+    Iterator lower_bound(const K& value) const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        return Iterator(bound_node(value, false), this);
     }
 
-    Iterator begin() const {
-        std::shared_lock<std::shared_mutex> lock(mtx);
-        Node* current = root;
-        while (current != nil && current->left != nil) {
-            current = current->left;
+    template <typename K>
+    Iterator upper_bound(const K& value) const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        return Iterator(bound_node(value, true), this);
+    }
+
+    template <typename K>
+    std::pair<Iterator, Iterator> equal_range(const K& value) const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        return {Iterator(bound_node(value, false), this), Iterator(bound_node(value, true), this)};
+    }
+
+    //число ключей в [lo, hi); размеров поддеревьев в узлах нет,
+    //поэтому после спуска к lo ключи диапазона проходятся: O(log n + k)
+    template <typename K>
+    std::size_t count_range(const K& lo, const K& hi) const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        std::size_t count = 0;
+        for (Node* node = bound_node(lo, false); node != nil && node->data < hi; node = successor(node)) {
+            ++count;
         }
-        return Iterator(current, nil, &mtx);
+        return count;
+    }
+
+    //согласованная версия за O(1): берётся ссылка на текущий корень индекса,
+    //дальше писатели копируют изменённые пути, не трогая узлы снимка
+    Snapshot snapshot() const {
+        ReaderDomain::Guard guard(readers);
+        snapshots.fetch_add(1);
+        return Snapshot(this, index_acquire(read_root.load()));
+    }
+
+    //сумма счётчиков всех потоков; для Set без SetStats - пустая структура
+    typename Stats::Totals stats() const {
+        return counters.read();
+    }
+
+    //высота дерева обходом под shared_lock, O(n)
+    std::size_t height() const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        return Core::height(root);
+    }
+
+    //неизменяемый снимок для фаз, где почти только читают; копирование под shared_lock
+    FrozenSet<T> freeze() const {
+        std::vector<T> sorted;
+        {
+            std::shared_lock<std::shared_mutex> lock = lock_shared();
+            for (Node* node = minimum(root); node != nil; node = successor(node)) {
+                sorted.push_back(node->data);
+            }
+        }
+        return FrozenSet<T>(sorted);
+    }
+
+    Iterator begin() const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        return Iterator(minimum(root), this);
     }
 
     Iterator end() const {
-        std::shared_lock<std::shared_mutex> lock(mtx);
-        return Iterator(nil, nil, &mtx);
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        return Iterator(nil, this);
     }
 
     bool empty() const {
-        std::shared_lock<std::shared_mutex> lock(mtx);
+        return read_root.load() == nullptr;
+    }
+
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        destroy_all();
+    }
+};
+
+//упорядоченный словарь на том же дереве, что и Set. Чтение под shared_lock,
+//изменения под unique_lock; поиск места и изменение значения - под одной блокировкой.
+//Индекса без блокировок, как у Set, нет: значения меняются на месте
+template <typename K, typename V, template <typename> class Pool = SlabPool, typename Stats = NoStats>
+class Map : private RBTree<std::pair<const K, V>, PairKey, Pool, Stats> {
+public:
+    using value_type = std::pair<const K, V>;
+
+private:
+    using Core = RBTree<value_type, PairKey, Pool, Stats>;
+    using typename Core::Node;
+    using Core::root;
+    using Core::nil;
+    using Core::lock_unique;
+    using Core::lock_shared;
+    using Core::minimum;
+    using Core::successor;
+    using Core::find_from;
+    using Core::insert_from;
+    using Core::delete_node;
+    using Core::destroy_nodes;
+    using Core::counters;
+
+    //значение для key; если ключа нет, пара собирается в узле из key и args
+    template <typename... Args>
+    std::pair<Node*, bool> find_or_insert(const K& key, Args&&... args) {
+        return insert_from(root, key, std::piecewise_construct,
+                           std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+public:
+    Map() = default;
+
+    //значение по ключу, при отсутствии вставляется V(). Ссылка живёт до удаления ключа,
+    //но запись через неё из разных потоков не защищена - для этого есть update
+    V& operator[](const K& key) {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        return find_or_insert(key).first->data.second;
+    }
+
+    //вставка без перезаписи; true, если ключа не было
+    bool insert(const K& key, const V& value) {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        return find_or_insert(key, value).second;
+    }
+
+    //вставка или замена значения; true, если ключа не было
+    template <typename U>
+    bool insert_or_assign(const K& key, U&& value) {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        std::pair<Node*, bool> result = find_or_insert(key, std::forward<U>(value));
+        if (!result.second) {
+            result.first->data.second = std::forward<U>(value);
+        }
+        return result.second;
+    }
+
+    //изменение значения на месте: f(V&) вызывается под той же блокировкой, что и поиск;
+    //false, если ключа нет
+    template <typename F>
+    bool update(const K& key, F f) {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        Node* node = find_from(root, key);
+        if (node == nil) {
+            return false;
+        }
+        f(node->data.second);
+        return true;
+    }
+
+    //то же, но отсутствующий ключ сначала вставляется со значением V()
+    template <typename F>
+    void upsert(const K& key, F f) {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        f(find_or_insert(key).first->data.second);
+    }
+
+    //копия значения под shared_lock; ключ может быть любого типа, сравнимого с K
+    template <typename Key>
+    std::optional<V> get(const Key& key) const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        Node* node = find_from(root, key);
+        if (node == nil) {
+            return std::nullopt;
+        }
+        return node->data.second;
+    }
+
+    template <typename Key>
+    bool contains(const Key& key) const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        return find_from(root, key) != nil;
+    }
+
+    //true, если ключ был
+    bool erase(const K& key) {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        Node* node = find_from(root, key);
+        if (node == nil) {
+            return false;
+        }
+        delete_node(node);
+        return true;
+    }
+
+    //обход пар по возрастанию ключей под одной shared_lock: видно согласованное состояние
+    template <typename F>
+    void for_each(F f) const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
+        for (Node* node = minimum(root); node != nil; node = successor(node)) {
+            f(static_cast<const value_type&>(node->data));
+        }
+    }
+
+    typename Stats::Totals stats() const {
+        return counters.read();
+    }
+
+    bool empty() const {
+        std::shared_lock<std::shared_mutex> lock = lock_shared();
         return root == nil;
     }
+
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock = lock_unique();
+        destroy_nodes();
+    }
+};
+
+//множество без блокировок на списке с пропусками: вставка и удаление - CAS по ссылкам,
+//поворотов нет, поэтому потоки мешают друг другу только в месте изменения.
+//Удалённый узел сначала помечается (младший бит его ссылок), потом вырезается из уровней,
+//а память освобождается пачками после ухода всех читателей (ReaderDomain).
+//Писатели читателей не ждут: пока читатели есть, пачка откладывается, поэтому живой
+//итератор задерживает освобождение памяти (но не вставки и удаления)
+template <typename T>
+class ConcurrentSet {
+private:
+    static constexpr int max_level = 16;              //уровень растёт с вероятностью 1/4
+    static constexpr std::size_t retire_batch = 1024;
+
+    using Link = std::atomic<std::uintptr_t>; //указатель на следующий узел и бит пометки
+
+    //ссылки узла лежат сразу за ним, их столько, сколько у узла уровней
+    //owners: вставляющий и удаляющий поток; последний из них вырезает узел окончательно
+    //и отдаёт его на освобождение, иначе вставка могла бы вернуть узел на верхний уровень
+    //уже после того, как удаляющий его оттуда убрал
+    struct alignas(Link) Node {
+        T data;
+        int height;
+        std::atomic<int> owners{2};
+
+        template <typename U>
+        Node(U&& d, int h) : data(std::forward<U>(d)), height(h) {}
+
+        Link* next() {
+            return reinterpret_cast<Link*>(this + 1);
+        }
+    };
+
+    static Node* ptr(std::uintptr_t link) {
+        return reinterpret_cast<Node*>(link & ~std::uintptr_t(1));
+    }
+
+    static bool marked(std::uintptr_t link) {
+        return link & 1;
+    }
+
+    static std::uintptr_t raw(Node* node) {
+        return reinterpret_cast<std::uintptr_t>(node);
+    }
+
+    template <typename U>
+    static Node* create(U&& value, int height) {
+        void* memory = ::operator new(sizeof(Node) + height * sizeof(Link));
+        Node* node = new (memory) Node(std::forward<U>(value), height);
+        for (int level = 0; level < height; ++level) {
+            new (&node->next()[level]) Link(0);
+        }
+        return node;
+    }
+
+    static void destroy(Node* node) {
+        node->~Node();
+        ::operator delete(node);
+    }
+
+    //первый непомеченный узел нижнего уровня, начиная с node
+    static Node* skip_marked(Node* node) {
+        while (node != nullptr && marked(node->next()[0].load())) {
+            node = ptr(node->next()[0].load());
+        }
+        return node;
+    }
+
+    //пока поток держит ReaderDomain::Guard, узлы, до которых он мог дойти, не освобождаются
+    Node* head; //без данных, на всех уровнях; конец уровня - nullptr
+    mutable ReaderDomain readers;
+    std::mutex retire_mtx; //списки ниже и круги ожидания читателей
+    std::vector<Node*> retired;
+    std::vector<Node*> pending; //пачка, ждущая двух кругов ReaderDomain
+    unsigned pending_phase = 0; //фаза, читателей которой ждёт текущий круг
+    int pending_rounds = 0;
+
+    static int random_height() {
+        static thread_local unsigned seed =
+            static_cast<unsigned>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        int height = 1;
+        for (unsigned bits = seed; height < max_level && (bits & 3) == 0; bits >>= 2) {
+            ++height;
+        }
+        return height;
+    }
+
+    //на каждом уровне ищет последний узел < value (preds) и следующий за ним (succs),
+    //попутно вырезая помеченные узлы; true, если succs[0] равен value
+    template <typename K>
+    bool find(const K& value, Node** preds, Node** succs) {
+    retry:
+        Node* pred = head;
+        for (int level = max_level - 1; level >= 0; --level) {
+            Node* curr = ptr(pred->next()[level].load());
+            while (curr != nullptr) {
+                std::uintptr_t succ = curr->next()[level].load();
+                if (marked(succ)) {
+                    std::uintptr_t expected = raw(curr);
+                    if (!pred->next()[level].compare_exchange_strong(expected, raw(ptr(succ)))) {
+                        goto retry; //pred изменился или сам помечен
+                    }
+                    curr = ptr(succ);
+                } else if (curr->data < value) {
+                    pred = curr;
+                    curr = ptr(succ);
+                } else {
+                    break;
+                }
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return succs[0] != nullptr && !(value < succs[0]->data);
+    }
+
+    //узел вырезан со всех уровней; освобождается после ухода читателей. Вместо
+    //synchronize круги идут по шагу на вызов: если читатели старой фазы ещё есть,
+    //пачка ждёт следующего удаления, а писатель не блокируется
+    void retire(Node* node) {
+        std::vector<Node*> batch;
+        {
+            std::lock_guard<std::mutex> lock(retire_mtx);
+            retired.push_back(node);
+            if (pending.empty()) {
+                if (retired.size() < retire_batch) {
+                    return;
+                }
+                pending.swap(retired);
+                pending_phase = readers.flip();
+                pending_rounds = 0;
+                return;
+            }
+            if (!readers.drained(pending_phase)) {
+                return;
+            }
+            if (++pending_rounds < 2) {
+                pending_phase = readers.flip();
+                return;
+            }
+            batch.swap(pending);
+        }
+        for (Node* old : batch) {
+            destroy(old);
+        }
+    }
+
+public:
+    //обход нижнего уровня; итератор держит отметку читателя, поэтому его узлы не освобождаются.
+    //Видны элементы, не удалённые к моменту шага. Пока итератор жив, удалённые узлы
+    //всего множества копятся и не освобождаются - долго хранить итераторы не стоит
+    class Iterator {
+    private:
+        Node* node;
+        std::shared_ptr<ReaderDomain::Guard> guard;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        Iterator(Node* n, std::shared_ptr<ReaderDomain::Guard> g) : node(skip_marked(n)), guard(std::move(g)) {}
+
+        reference operator*() const {
+            return node->data;
+        }
+
+        pointer operator->() const {
+            return &node->data;
+        }
+
+        Iterator& operator++() {
+            node = skip_marked(ptr(node->next()[0].load()));
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return node == other.node;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+    };
+
+    ConcurrentSet() {
+        head = create(T(), max_level);
+    }
+
+    ConcurrentSet(const ConcurrentSet&) = delete;
+    ConcurrentSet& operator=(const ConcurrentSet&) = delete;
+
+    ~ConcurrentSet() {
+        Node* node = ptr(head->next()[0].load());
+        while (node != nullptr) {
+            Node* next = ptr(node->next()[0].load());
+            destroy(node);
+            node = next;
+        }
+        for (Node* old : retired) {
+            destroy(old);
+        }
+        for (Node* old : pending) {
+            destroy(old);
+        }
+        destroy(head);
+    }
+
+    //узел сначала включается в нижний уровень (момент вставки), потом в верхние
+    bool insert(const T& value) {
+        int height = random_height();
+        Node* preds[max_level];
+        Node* succs[max_level];
+        Node* node = nullptr;
+        {
+            ReaderDomain::Guard guard(readers);
+            while (true) {
+                if (find(value, preds, succs)) {
+                    if (node != nullptr) {
+                        destroy(node); //его ещё никто не видел
+                    }
+                    return false;
+                }
+                if (node == nullptr) {
+                    node = create(value, height);
+                }
+                for (int level = 0; level < height; ++level) {
+                    node->next()[level].store(raw(succs[level]));
+                }
+                std::uintptr_t expected = raw(succs[0]);
+                if (preds[0]->next()[0].compare_exchange_strong(expected, raw(node))) {
+                    break;
+                }
+            }
+            for (int level = 1; level < height; ++level) {
+                while (true) {
+                    //ссылку узла на этом уровне меняем CAS: если её уже пометили, узел удаляют
+                    std::uintptr_t old = node->next()[level].load();
+                    if (marked(old)) {
+                        break;
+                    }
+                    if (ptr(old) != succs[level] &&
+                        !node->next()[level].compare_exchange_strong(old, raw(succs[level]))) {
+                        break;
+                    }
+                    std::uintptr_t expected = raw(succs[level]);
+                    if (preds[level]->next()[level].compare_exchange_strong(expected, raw(node))) {
+                        break;
+                    }
+                    find(value, preds, succs);
+                }
+            }
+            if (node->owners.fetch_sub(1) != 1) {
+                return true;
+            }
+            find(value, preds, succs); //узел удалили, пока он включался в верхние уровни
+        }
+        retire(node);
+        return true;
+    }
+
+    //пометка нижнего уровня - момент удаления; вырезает узел вызов find
+    bool erase(const T& value) {
+        Node* preds[max_level];
+        Node* succs[max_level];
+        Node* victim;
+        {
+            ReaderDomain::Guard guard(readers);
+            if (!find(value, preds, succs)) {
+                return false;
+            }
+            victim = succs[0];
+            for (int level = victim->height - 1; level > 0; --level) {
+                std::uintptr_t succ = victim->next()[level].load();
+                while (!marked(succ) && !victim->next()[level].compare_exchange_weak(succ, succ | 1)) {
+                }
+            }
+            std::uintptr_t succ = victim->next()[0].load();
+            while (true) {
+                if (marked(succ)) {
+                    return false; //удалил другой поток
+                }
+                if (victim->next()[0].compare_exchange_weak(succ, succ | 1)) {
+                    break;
+                }
+            }
+            find(value, preds, succs);
+            if (victim->owners.fetch_sub(1) != 1) {
+                return true; //освободит вставляющий поток
+            }
+            find(value, preds, succs);
+        }
+        retire(victim);
+        return true;
+    }
+
+    //только чтение: помеченные узлы пропускаются, но не вырезаются
+    template <typename K>
+    bool contains(const K& value) const {
+        ReaderDomain::Guard guard(readers);
+        Node* pred = head;
+        Node* curr = nullptr;
+        for (int level = max_level - 1; level >= 0; --level) {
+            curr = ptr(pred->next()[level].load());
+            while (curr != nullptr) {
+                std::uintptr_t succ = curr->next()[level].load();
+                if (marked(succ)) {
+                    curr = ptr(succ);
+                } else if (curr->data < value) {
+                    pred = curr;
+                    curr = ptr(succ);
+                } else {
+                    break;
+                }
+            }
+        }
+        return curr != nullptr && !(value < curr->data);
+    }
+
+    Iterator begin() const {
+        std::shared_ptr<ReaderDomain::Guard> guard = std::make_shared<ReaderDomain::Guard>(readers);
+        return Iterator(ptr(head->next()[0].load()), std::move(guard));
+    }
+
+    Iterator end() const {
+        return Iterator(nullptr, nullptr);
+    }
+
+    bool empty() const {
+        ReaderDomain::Guard guard(readers);
+        return skip_marked(ptr(head->next()[0].load())) == nullptr;
+    }
 };
 
 int main() {
@@ -411,6 +1989,113 @@ int main() {
     }
     std::cout << std::endl;
 
+    //диапазон [3, 12) и обход в обратном порядке от end()
+    std::cout << "Ключей в [3, 12): " << s.count_range(3, 12)
+              << ", первый >= 8: " << *s.lower_bound(8) << std::endl;
+    std::cout << "В обратном порядке: ";
+    for (auto it = s.end(); it != s.begin();) {
+        --it;
+        std::cout << *it << " ";
+    }
+    std::cout << std::endl;
+
+    //массовая загрузка: узлы берутся из слэбов, clear() отдаёт их целиком
+    Set<int> big;
+    for (int i = 0; i < 100000; ++i) {
+        big.insert(i);
+    }
+    //снимок для чтения без блокировок и без обхода указателей
+    FrozenSet<int> frozen = big.freeze();
+    const int* first_big = frozen.lower_bound(50000);
+    std::cout << "Снимок: " << frozen.size() << " ключей, первый >= 50000: "
+              << (first_big ? *first_big : -1) << std::endl;
+
+    //версия до clear остаётся доступной через snapshot
+    Set<int>::Snapshot before_clear = big.snapshot();
+    big.clear();
+    std::cout << "После clear пусто: " << big.empty()
+              << ", в снимке есть 99999: " << before_clear.contains(99999) << std::endl;
+
+    //пачка ключей под одной блокировкой
+    std::vector<int> batch = {42, 3, 17, 8, 99, 3};
+    big.insert_batch(batch.begin(), batch.end());
+    big.erase_batch(batch.begin(), batch.begin() + 2);
+    std::cout << "После пачек: ";
+    for (const auto& value : big) {
+        std::cout << value << " ";
+    }
+    std::cout << std::endl;
+
+
+    //замеры горячего пути: четыре потока вставляют и удаляют свои ключи
+    Set<int, SlabPool, SetStats> measured;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&measured, t] {
+            for (int i = 0; i < 20000; ++i) {
+                measured.insert(i * 4 + t);
+            }
+            for (int i = 0; i < 20000; i += 2) {
+                measured.erase(i * 4 + t);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    SetStats::Totals totals = measured.stats();
+    std::cout << "Вставок: " << totals.inserts << ", удалений: " << totals.erases
+              << ", высота: " << measured.height() << std::endl;
+    std::cout << "На операцию: поворотов " << totals.per_op(totals.rotations)
+              << ", перекрасок " << totals.per_op(totals.recolors)
+              << ", копий узлов индекса " << totals.per_op(totals.index_allocations) << std::endl;
+    std::cout << "Ожидание unique_lock: " << totals.unique_wait_ns / 1000000 << " мс на "
+              << totals.unique_locks << " захватов" << std::endl;
+
+    //словарь: подсчёт слов из нескольких потоков, увеличение под одной блокировкой
+    Map<std::string, int> words;
+    std::vector<std::thread> counters;
+    for (int t = 0; t < 4; ++t) {
+        counters.emplace_back([&words] {
+            for (const char* word : {"red", "black", "red", "tree"}) {
+                words.upsert(word, [](int& count) { ++count; });
+            }
+        });
+    }
+    for (std::thread& counter : counters) {
+        counter.join();
+    }
+    words.insert_or_assign("root", 1);
+    words["leaf"] += 2;
+    std::cout << "Слова:";
+    words.for_each([](const std::pair<const std::string, int>& entry) {
+        std::cout << " " << entry.first << "=" << entry.second;
+    });
+    std::cout << std::endl;
+
+    //список с пропусками без блокировок: чётные вставляют, нечётные удаляют
+    ConcurrentSet<int> skip;
+    std::vector<std::thread> skip_workers;
+    for (int t = 0; t < 4; ++t) {
+        skip_workers.emplace_back([&skip, t] {
+            for (int i = 0; i < 10000; ++i) {
+                if (t % 2 == 0) {
+                    skip.insert(i % 100);
+                } else {
+                    skip.erase(i % 100 + 50);
+                }
+            }
+        });
+    }
+    for (std::thread& worker : skip_workers) {
+        worker.join();
+    }
+    int skip_size = 0;
+    for (auto it = skip.begin(); it != skip.end(); ++it) {
+        ++skip_size;
+    }
+    std::cout << "Список с пропусками: " << skip_size << " элементов, 10 - "
+              << skip.contains(10) << std::endl;
 
     Set<int> shared_set;
     std::mutex cout_mtx;
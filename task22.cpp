@@ -1,4 +1,284 @@
 #include <iostream>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <type_traits>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Формат файла для Set::save / Set::open_mapped.
+// После заголовка идут узлы в порядке возрастания ключей; вместо указателей - номера
+// потомков в этом массиве, поэтому файл не зависит от адреса, по которому его отобразят.
+// Порядок байт - как у машины, которая писала файл
+struct SetFileHeader {
+    char magic[8];         // "RBSET01"
+    uint32_t key_size;     // sizeof(T), защита от чтения файла с другим типом ключа
+    uint32_t node_size;    // Размер записи узла
+    uint64_t count;        // Количество узлов
+    uint64_t root;         // Номер корня (no_node, если множество пустое)
+};
+
+constexpr uint64_t no_node = UINT64_MAX;
+
+// Узел в файле
+template <typename T>
+struct SetFileNode {
+    T data;          // Ключ
+    uint64_t left;   // Номер левого потомка или no_node
+    uint64_t right;  // Номер правого потомка или no_node
+};
+
+// Множество только для чтения поверх отображённого в память файла:
+// contains и обход работают сразу, без чтения и разбора файла
+template <typename T>
+class MappedSet {
+private:
+    using DiskNode = SetFileNode<T>;
+
+    void* base = nullptr;        // Начало отображения
+    size_t length = 0;           // Длина отображения
+    const DiskNode* nodes = nullptr;
+    uint64_t count = 0;
+    uint64_t root = no_node;
+
+    void unmap() {
+        if (base != nullptr) {
+            munmap(base, length);
+        }
+        base = nullptr;
+        nodes = nullptr;
+        count = 0;
+        root = no_node;
+    }
+
+public:
+    MappedSet() = default;
+
+    // Отображает файл; при ошибке множество остаётся закрытым (is_open() == false)
+    explicit MappedSet(const std::string& path) {
+        static_assert(std::is_trivially_copyable<T>::value, "в файл пишутся только тривиально копируемые ключи");
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SetFileHeader)) {
+            ::close(fd);
+            return;
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // Отображение живёт и без открытого дескриптора
+        if (mapped == MAP_FAILED) return;
+        base = mapped;
+
+        // Проверяем заголовок и что все узлы действительно лежат в файле
+        const SetFileHeader* header = static_cast<const SetFileHeader*>(base);
+        bool valid = std::memcmp(header->magic, "RBSET01", 8) == 0
+            && header->key_size == sizeof(T)
+            && header->node_size == sizeof(DiskNode)
+            && header->count <= (length - sizeof(SetFileHeader)) / sizeof(DiskNode)
+            && (header->root < header->count || (header->root == no_node && header->count == 0));
+        if (!valid) {
+            unmap();
+            return;
+        }
+        nodes = reinterpret_cast<const DiskNode*>(static_cast<const char*>(base) + sizeof(SetFileHeader));
+        count = header->count;
+        root = header->root;
+    }
+
+    MappedSet(const MappedSet&) = delete;
+    MappedSet& operator=(const MappedSet&) = delete;
+
+    MappedSet(MappedSet&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedSet& operator=(MappedSet&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            base = other.base;
+            length = other.length;
+            nodes = other.nodes;
+            count = other.count;
+            root = other.root;
+            other.base = nullptr;
+            other.unmap();
+        }
+        return *this;
+    }
+
+    ~MappedSet() {
+        unmap();
+    }
+
+    bool is_open() const {
+        return base != nullptr;
+    }
+
+    // Поиск спуском по номерам потомков. Файл может быть испорчен и содержать цикл,
+    // поэтому шагов не больше count и не больше 128 - высоты красно-чёрного дерева
+    // из 2^64 узлов; дальше поиск считается неудачным
+    template <typename K>
+    bool contains(const K& value) const {
+        uint64_t current = root;
+        uint64_t steps = count < 128 ? count : 128;
+        for (; steps > 0 && current < count; --steps) {
+            const DiskNode& node = nodes[current];
+            if (value < node.data) {
+                current = node.left;
+            } else if (node.data < value) {
+                current = node.right;
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    // Итератор просто идёт по массиву: узлы записаны по возрастанию, ссылки на потомков
+    // не используются, так что обход всегда кончается через count шагов
+    class Iterator {
+    private:
+        const DiskNode* node;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        explicit Iterator(const DiskNode* n) : node(n) {}
+
+        reference operator*() const {
+            return node->data;
+        }
+
+        pointer operator->() const {
+            return &node->data;
+        }
+
+        Iterator& operator++() {
+            ++node;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++node;
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return node == other.node;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+    };
+
+    Iterator begin() const {
+        return Iterator(nodes);
+    }
+
+    Iterator end() const {
+        return Iterator(nodes + count);
+    }
+};
+
+// Пул узлов: узлы лежат в блоках по block_nodes штук, удалённые идут в список свободных.
+// Отдельный new на узел добавляет заголовок malloc и округление до 16 байт:
+// узел Set<int> в 32 байта занимал бы 48
+template <typename N>
+class NodePool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(N) unsigned char storage[sizeof(N)];
+    };
+
+    static constexpr size_t block_nodes = 1024;
+
+    std::vector<Slot*> blocks;
+    Slot* free_list = nullptr;
+    size_t used = block_nodes; // Занято слотов в последнем блоке
+
+public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool() {
+        release();
+    }
+
+    template <typename... Args>
+    N* create(Args&&... args) {
+        Slot* slot;
+        if (free_list != nullptr) {
+            slot = free_list;
+            free_list = slot->next;
+        } else {
+            if (used == block_nodes) {
+                blocks.push_back(new Slot[block_nodes]);
+                used = 0;
+            }
+            slot = &blocks.back()[used++];
+        }
+        return new (slot->storage) N(std::forward<Args>(args)...);
+    }
+
+    void destroy(N* node) {
+        node->~N();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+    // Отдельный блок ровно под count узлов: build создаёт в нём узлы через create_at
+    // из нескольких потоков без блокировок, каждый поток - в своей части блока.
+    // Блок ставится в начало, чтобы create продолжал заполнять последний
+    void* reserve(size_t count) {
+        Slot* block = new Slot[count];
+        blocks.insert(blocks.begin(), block);
+        return block;
+    }
+
+    template <typename... Args>
+    static N* create_at(void* block, size_t i, Args&&... args) {
+        return new (static_cast<Slot*>(block)[i].storage) N(std::forward<Args>(args)...);
+    }
+
+    // Освобождает все блоки; узлы к этому моменту должны быть уничтожены
+    void release() {
+        for (Slot* block : blocks) {
+            delete[] block;
+        }
+        blocks.clear();
+        free_list = nullptr;
+        used = block_nodes;
+    }
+};
 
 // Шаблонный класс Set с элементами типа T
 template <typename T>
@@ -7,21 +287,44 @@ private:
     // Перечисление цветов узлов: КРАСНЫЙ или ЧЁРНЫЙ
     enum Color { RED, BLACK };
     
-    // Структура узла дерева
+    // Структура узла дерева. Цвет хранится в младшем бите указателя на родителя:
+    // узлы выровнены минимум по 8 байт, и этот бит у адреса всегда нулевой.
+    // Для Set<int> узел занимает 32 байта вместо 40, и благодаря NodePool
+    // столько же на элемент уходит памяти (через new было бы 48)
     struct Node {
-        T data;           // Данные элемента
-        Node* parent;     // Указатель на родителя
-        Node* left;       // Указатель на левого потомка
-        Node* right;      // Указатель на правого потомка
-        Color color;      // Цвет узла (для балансировки)
+        T data;                      // Данные элемента
+        Node* left;                  // Указатель на левого потомка
+        Node* right;                 // Указатель на правого потомка
+        std::uintptr_t parent_color; // Родитель и цвет в одном слове
 
         // Конструктор узла с заданным значением
         Node(const T& d) 
-            : data(d), parent(nullptr), left(nullptr), right(nullptr), color(RED) {}
+            : data(d), left(nullptr), right(nullptr), parent_color(RED) {}
+
+        // Конструктор узла, забирающий значение
+        Node(T&& d)
+            : data(std::move(d)), left(nullptr), right(nullptr), parent_color(RED) {}
+
+        Node* parent() const {
+            return reinterpret_cast<Node*>(parent_color & ~std::uintptr_t(1));
+        }
+
+        void set_parent(Node* p) {
+            parent_color = reinterpret_cast<std::uintptr_t>(p) | (parent_color & 1);
+        }
+
+        Color color() const {
+            return static_cast<Color>(parent_color & 1);
+        }
+
+        void set_color(Color c) {
+            parent_color = (parent_color & ~std::uintptr_t(1)) | c;
+        }
     };
 
     Node* root; // Корень дерева
     Node* nil;  // Специальный "нулевой" узел (заменяет nullptr для упрощения алгоритмов)
+    NodePool<Node> pool; // Откуда берутся все узлы, кроме nil
 
     // Левый поворот дерева вокруг узла x (для балансировки)
     void left_rotate(Node* x) {
@@ -29,21 +332,21 @@ private:
         x->right = y->left;
         
         if (y->left != nil) {
-            y->left->parent = x;
+            y->left->set_parent(x);
         }
         
-        y->parent = x->parent;
+        y->set_parent(x->parent());
         
-        if (x->parent == nil) {
+        if (x->parent() == nil) {
             root = y;
-        } else if (x == x->parent->left) {
-            x->parent->left = y;
+        } else if (x == x->parent()->left) {
+            x->parent()->left = y;
         } else {
-            x->parent->right = y;
+            x->parent()->right = y;
         }
         
         y->left = x;
-        x->parent = y;
+        x->set_parent(y);
     }
 
     // Правый поворот дерева вокруг узла x (для балансировки)
@@ -52,65 +355,65 @@ private:
         x->left = y->right;
         
         if (y->right != nil) {
-            y->right->parent = x;
+            y->right->set_parent(x);
         }
         
-        y->parent = x->parent;
+        y->set_parent(x->parent());
         
-        if (x->parent == nil) {
+        if (x->parent() == nil) {
             root = y;
-        } else if (x == x->parent->right) {
-            x->parent->right = y;
+        } else if (x == x->parent()->right) {
+            x->parent()->right = y;
         } else {
-            x->parent->left = y;
+            x->parent()->left = y;
         }
         
         y->right = x;
-        x->parent = y;
+        x->set_parent(y);
     }
 
     // Восстановление свойств чёрно-красного дерева после вставки
     void fix_insert(Node* k) {
-        while (k != root && k->parent->color == RED) {
-            if (k->parent == k->parent->parent->left) {
-                Node* uncle = k->parent->parent->right;
+        while (k != root && k->parent()->color() == RED) {
+            if (k->parent() == k->parent()->parent()->left) {
+                Node* uncle = k->parent()->parent()->right;
                 
-                if (uncle->color == RED) {
-                    k->parent->color = BLACK;
-                    uncle->color = BLACK;
-                    k->parent->parent->color = RED;
-                    k = k->parent->parent;
+                if (uncle->color() == RED) {
+                    k->parent()->set_color(BLACK);
+                    uncle->set_color(BLACK);
+                    k->parent()->parent()->set_color(RED);
+                    k = k->parent()->parent();
                 } else {
-                    if (k == k->parent->right) {
-                        k = k->parent;
+                    if (k == k->parent()->right) {
+                        k = k->parent();
                         left_rotate(k);
                     }
                     
-                    k->parent->color = BLACK;
-                    k->parent->parent->color = RED;
-                    right_rotate(k->parent->parent);
+                    k->parent()->set_color(BLACK);
+                    k->parent()->parent()->set_color(RED);
+                    right_rotate(k->parent()->parent());
                 }
             } else {
-                Node* uncle = k->parent->parent->left;
+                Node* uncle = k->parent()->parent()->left;
                 
-                if (uncle->color == RED) {
-                    k->parent->color = BLACK;
-                    uncle->color = BLACK;
-                    k->parent->parent->color = RED;
-                    k = k->parent->parent;
+                if (uncle->color() == RED) {
+                    k->parent()->set_color(BLACK);
+                    uncle->set_color(BLACK);
+                    k->parent()->parent()->set_color(RED);
+                    k = k->parent()->parent();
                 } else {
-                    if (k == k->parent->left) {
-                        k = k->parent;
+                    if (k == k->parent()->left) {
+                        k = k->parent();
                         right_rotate(k);
                     }
                     
-                    k->parent->color = BLACK;
-                    k->parent->parent->color = RED;
-                    left_rotate(k->parent->parent);
+                    k->parent()->set_color(BLACK);
+                    k->parent()->parent()->set_color(RED);
+                    left_rotate(k->parent()->parent());
                 }
             }
         }
-        root->color = BLACK;
+        root->set_color(BLACK);
     }
 
     // Находит узел с минимальным значением в поддереве
@@ -121,16 +424,136 @@ private:
         return node;
     }
 
-    // Рекурсивное удаление всех узлов дерева
+    // Находит узел с максимальным значением в поддереве
+    Node* maximum(Node* node) const {
+        while (node->right != nil) {
+            node = node->right;
+        }
+        return node;
+    }
+
+    // Следующий по порядку узел (nil, если node - максимальный)
+    Node* successor(Node* node) const {
+        if (node->right != nil) {
+            return minimum(node->right);
+        }
+        Node* parent = node->parent();
+        while (parent != nil && node == parent->right) {
+            node = parent;
+            parent = parent->parent();
+        }
+        return parent;
+    }
+
+    // Предыдущий по порядку узел (nil, если node - минимальный)
+    Node* predecessor(Node* node) const {
+        if (node->left != nil) {
+            return maximum(node->left);
+        }
+        Node* parent = node->parent();
+        while (parent != nil && node == parent->left) {
+            node = parent;
+            parent = parent->parent();
+        }
+        return parent;
+    }
+
+    // Удаление всех узлов без рекурсии и без стека: левый потомок поворотом
+    // поднимается наверх, пока у узла его нет; тогда узел удаляется и спуск
+    // продолжается вправо. Каждый узел поворачивается не больше одного раза - O(n)
     void clear(Node* node) {
-        if (node == nil) return;
-        clear(node->left);
-        clear(node->right);
-        delete node;
+        while (node != nil) {
+            if (node->left != nil) {
+                Node* left = node->left;
+                node->left = left->right;
+                left->right = node;
+                node = left;
+            } else {
+                Node* right = node->right;
+                pool.destroy(node);
+                node = right;
+            }
+        }
+    }
+
+    // Строит идеально сбалансированное поддерево из sorted[lo, hi) за линейное время.
+    // Все листья лежат на глубине max_depth или max_depth - 1; узлы на самой нижней
+    // глубине красные, остальные чёрные - так у всех путей одинаковая чёрная высота.
+    // Пока spawn_levels > 0, левая половина строится в отдельном потоке; поддеревья
+    // меньше parallel_cutoff строятся в одном потоке - поток дороже такой работы.
+    // Узел для sorted[i] создаётся в i-м слоте block из NodePool::reserve
+    Node* build(const std::vector<T>& sorted, size_t lo, size_t hi, Node* parent,
+                int depth, int max_depth, int spawn_levels, void* block) {
+        if (lo == hi) {
+            return nil;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        Node* node = NodePool<Node>::create_at(block, mid, sorted[mid]);
+        node->set_parent(parent);
+        node->set_color((depth == max_depth && depth > 0) ? RED : BLACK);
+
+        if (spawn_levels > 0 && hi - lo >= parallel_cutoff) {
+            std::thread left_builder([&] {
+                node->left = build(sorted, lo, mid, node, depth + 1, max_depth, spawn_levels - 1, block);
+            });
+            node->right = build(sorted, mid + 1, hi, node, depth + 1, max_depth, spawn_levels - 1, block);
+            left_builder.join();
+        } else {
+            node->left = build(sorted, lo, mid, node, depth + 1, max_depth, 0, block);
+            node->right = build(sorted, mid + 1, hi, node, depth + 1, max_depth, 0, block);
+        }
+        return node;
     }
 
-    // Вспомогательная функция для поиска узла
-    Node* find_node(const T& value) const {
+    // Поддеревья меньше этого размера строятся в одном потоке
+    static constexpr size_t parallel_cutoff = 1 << 15;
+
+    // Заменяет содержимое деревом из отсортированных уникальных ключей
+    void rebuild(const std::vector<T>& sorted, unsigned threads) {
+        clear(root);
+        root = nil;
+        pool.release(); // Все узлы уже уничтожены, блоки больше не нужны
+        int max_depth = 0;
+        while ((size_t(2) << max_depth) <= sorted.size()) {
+            ++max_depth; // max_depth = floor(log2(n))
+        }
+        int spawn_levels = 0;
+        while ((1u << spawn_levels) < threads) {
+            ++spawn_levels;
+        }
+        void* block = sorted.empty() ? nullptr : pool.reserve(sorted.size());
+        root = build(sorted, 0, sorted.size(), nil, 0, max_depth, spawn_levels, block);
+    }
+
+    // Копирует диапазон в вектор, при необходимости сортирует и убирает повторы
+    template <typename InputIt>
+    static std::vector<T> sorted_unique(InputIt first, InputIt last) {
+        std::vector<T> values(first, last);
+        if (!std::is_sorted(values.begin(), values.end())) {
+            std::sort(values.begin(), values.end());
+        }
+        values.erase(std::unique(values.begin(), values.end(),
+                                 [](const T& a, const T& b) { return !(a < b) && !(b < a); }),
+                     values.end());
+        return values;
+    }
+
+    // Записывает поддерево в nodes в порядке возрастания, возвращает номер его корня
+    uint64_t flatten(Node* node, std::vector<SetFileNode<T>>& nodes) const {
+        if (node == nil) {
+            return no_node;
+        }
+        uint64_t left = flatten(node->left, nodes);
+        uint64_t index = nodes.size();
+        nodes.push_back(SetFileNode<T>{node->data, left, no_node});
+        uint64_t right = flatten(node->right, nodes);
+        nodes[index].right = right;
+        return index;
+    }
+
+    // Вспомогательная функция для поиска узла (ключ - любой тип, сравнимый с T)
+    template <typename K>
+    Node* find_node(const K& value) const {
         Node* current = root;
         while (current != nil) {
             if (value < current->data) {
@@ -144,23 +567,94 @@ private:
         return nil; // Не найдено
     }
 
+    // Первый узел с ключом не меньше value (upper = false) или строго больше (upper = true)
+    template <typename K>
+    Node* bound_node(const K& value, bool upper) const {
+        Node* result = nil;
+        Node* current = root;
+        while (current != nil) {
+            bool go_left = upper ? value < current->data : !(current->data < value);
+            if (go_left) {
+                result = current; // Кандидат, ищем ещё левее
+                current = current->left;
+            } else {
+                current = current->right;
+            }
+        }
+        return result;
+    }
+
+    // Вставка со спуском от узла start; возвращает узел со значением и true, если он новый
+    template <typename U>
+    std::pair<Node*, bool> insert_from(Node* start, U&& value) {
+        Node* y = nil;
+        Node* x = start;
+        
+        // Поиск места для вставки
+        while (x != nil) {
+            y = x;
+            if (value < x->data) {
+                x = x->left;
+            } else if (x->data < value) {
+                x = x->right;
+            } else {
+                // Элемент уже существует, выходим
+                return {x, false};
+            }
+        }
+
+        // Сторона выбирается до того, как value может быть перемещён в узел
+        bool as_left = y != nil && value < y->data;
+
+        // Создаём новый узел
+        Node* new_node = pool.create(std::forward<U>(value));
+        new_node->set_parent(y);
+        new_node->left = nil;
+        new_node->right = nil;
+        new_node->set_color(RED);
+
+        // Привязываем новый узел к дереву
+        if (y == nil) {
+            root = new_node;
+        } else if (as_left) {
+            y->left = new_node;
+        } else {
+            y->right = new_node;
+        }
+
+        // Балансируем дерево
+        fix_insert(new_node);
+        return {new_node, true};
+    }
+
+    // С чего начинать вставку по подсказке: если value встаёт сразу перед hint,
+    // у hint или у его предшественника есть свободное место ровно под value
+    Node* hint_start(Node* hint, const T& value) const {
+        Node* before = (hint == nil) ? maximum(root) : predecessor(hint);
+        bool fits = (hint == nil || value < hint->data) && (before == nil || before->data < value);
+        if (!fits) {
+            return root; // Подсказка неверна - обычный спуск от корня
+        }
+        return (hint != nil && hint->left == nil) ? hint : before;
+    }
+
     // Замена одного поддерева другим
     void transplant(Node* u, Node* v) {
-        if (u->parent == nil) {
+        if (u->parent() == nil) {
             root = v;
-        } else if (u == u->parent->left) {
-            u->parent->left = v;
+        } else if (u == u->parent()->left) {
+            u->parent()->left = v;
         } else {
-            u->parent->right = v;
+            u->parent()->right = v;
         }
-        v->parent = u->parent;
+        v->set_parent(u->parent());
     }
 
     // Вспомогательная функция для удаления узла
     void delete_node(Node* z) {
         Node* y = z;
         Node* x;
-        Color y_original_color = y->color;
+        Color y_original_color = y->color();
 
         if (z->left == nil) {
             x = z->right;
@@ -170,82 +664,82 @@ private:
             transplant(z, z->left);
         } else {
             y = minimum(z->right);
-            y_original_color = y->color;
+            y_original_color = y->color();
             x = y->right;
             
-            if (y->parent == z) {
-                x->parent = y;
+            if (y->parent() == z) {
+                x->set_parent(y);
             } else {
                 transplant(y, y->right);
                 y->right = z->right;
-                y->right->parent = y;
+                y->right->set_parent(y);
             }
             transplant(z, y);
             y->left = z->left;
-            y->left->parent = y;
-            y->color = z->color;
+            y->left->set_parent(y);
+            y->set_color(z->color());
         }
 
         if (y_original_color == BLACK) {
             fix_delete(x);
         }
-        delete z;
+        pool.destroy(z);
     }
 
     // Восстановление свойств чёрно-красного дерева после удаления
     void fix_delete(Node* x) {
-        while (x != root && x->color == BLACK) {
-            if (x == x->parent->left) {
-                Node* w = x->parent->right;
-                if (w->color == RED) {
-                    w->color = BLACK;
-                    x->parent->color = RED;
-                    left_rotate(x->parent);
-                    w = x->parent->right;
+        while (x != root && x->color() == BLACK) {
+            if (x == x->parent()->left) {
+                Node* w = x->parent()->right;
+                if (w->color() == RED) {
+                    w->set_color(BLACK);
+                    x->parent()->set_color(RED);
+                    left_rotate(x->parent());
+                    w = x->parent()->right;
                 }
-                if (w->left->color == BLACK && w->right->color == BLACK) {
-                    w->color = RED;
-                    x = x->parent;
+                if (w->left->color() == BLACK && w->right->color() == BLACK) {
+                    w->set_color(RED);
+                    x = x->parent();
                 } else {
-                    if (w->right->color == BLACK) {
-                        w->left->color = BLACK;
-                        w->color = RED;
+                    if (w->right->color() == BLACK) {
+                        w->left->set_color(BLACK);
+                        w->set_color(RED);
                         right_rotate(w);
-                        w = x->parent->right;
+                        w = x->parent()->right;
                     }
-                    w->color = x->parent->color;
-                    x->parent->color = BLACK;
-                    w->right->color = BLACK;
-                    left_rotate(x->parent);
+                    w->set_color(x->parent()->color());
+                    x->parent()->set_color(BLACK);
+                    w->right->set_color(BLACK);
+                    left_rotate(x->parent());
                     x = root;
                 }
             } else {
-                Node* w = x->parent->left;
-                if (w->color == RED) {
-                    w->color = BLACK;
-                    x->parent->color = RED;
-                    right_rotate(x->parent);
-                    w = x->parent->left;
+                Node* w = x->parent()->left;
+                if (w->color() == RED) {
+                    w->set_color(BLACK);
+                    x->parent()->set_color(RED);
+                    right_rotate(x->parent());
+                    w = x->parent()->left;
                 }
-                if (w->right->color == BLACK && w->left->color == BLACK) {
-                    w->color = RED;
-                    x = x->parent;
+                if (w->right->color() == BLACK && w->left->color() == BLACK) {
+                    w->set_color(RED);
+                    x = x->parent();
                 } else {
-                    if (w->left->color == BLACK) {
-                        w->right->color = BLACK;
-                        w->color = RED;
+                    if (w->left->color() == BLACK) {
+                        w->right->set_color(BLACK);
+                        w->set_color(RED);
                         left_rotate(w);
-                        w = x->parent->left;
+                        w = x->parent()->left;
                     }
-                    w->color = x->parent->color;
-                    x->parent->color = BLACK;
-                    w->left->color = BLACK;
-                    right_rotate(x->parent);
+                    w->set_color(x->parent()->color());
+                    x->parent()->set_color(BLACK);
+                    w->left->set_color(BLACK);
+                    right_rotate(x->parent());
                     x = root;
                 }
             }
         }
-        x->color = BLACK;
+        x->set_color(BLACK);
     }
 
 
@@ -254,7 +748,7 @@ public:
     class Iterator {
     private:
         Node* node;
-        Node* nil;
+        const Set* set; // нужен, чтобы шагнуть назад от end() к максимуму
 
     public:
         using iterator_category = std::bidirectional_iterator_tag;
@@ -263,7 +757,9 @@ public:
         using pointer = const T*;
         using reference = const T&;
 
-        Iterator(Node* n, Node* nil_node) : node(n), nil(nil_node) {}
+        friend class Set;
+
+        Iterator(Node* n, const Set* s) : node(n), set(s) {}
 
         reference operator*() const { 
             return node->data; 
@@ -274,19 +770,7 @@ public:
         }
 
         Iterator& operator++() {
-            if (node->right != nil) {
-                node = node->right;
-                while (node->left != nil) {
-                    node = node->left;
-                }
-            } else {
-                Node* parent = node->parent;
-                while (parent != nil && node == parent->right) {
-                    node = parent;
-                    parent = parent->parent;
-                }
-                node = parent;
-            }
+            node = set->successor(node);
             return *this;
         }
 
@@ -296,6 +780,18 @@ public:
             return tmp;
         }
 
+        // Шаг назад; от end() попадаем на максимальный элемент
+        Iterator& operator--() {
+            node = (node == set->nil) ? set->maximum(set->root) : set->predecessor(node);
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            Iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
         bool operator==(const Iterator& other) const {
             return node == other.node;
         }
@@ -308,11 +804,18 @@ public:
     // Конструктор: создаёт пустое дерево
     Set() {
         nil = new Node(T());
-        nil->color = BLACK;
-        nil->parent = nil->left = nil->right = nil;
+        nil->set_color(BLACK);
+        nil->left = nil->right = nil;
+        nil->set_parent(nil);
         root = nil;
     }
 
+    // Конструктор из диапазона: для отсортированного входа дерево строится за O(n)
+    template <typename InputIt>
+    Set(InputIt first, InputIt last) : Set() {
+        rebuild(sorted_unique(first, last), 1);
+    }
+
     // Деструктор: освобождает всю память
     ~Set() {
         clear(root);
@@ -321,40 +824,39 @@ public:
 
     // Вставка элемента в множество
     void insert(const T& value) {
-        Node* y = nil;
-        Node* x = root;
-        
-        // Поиск места для вставки
-        while (x != nil) {
-            y = x;
-            if (value < x->data) {
-                x = x->left;
-            } else if (x->data < value) {
-                x = x->right;
-            } else {
-                // Элемент уже существует, выходим
-                return;
-            }
-        }
+        insert_from(root, value);
+    }
 
-        // Создаём новый узел
-        Node* new_node = new Node(value);
-        new_node->parent = y;
-        new_node->left = nil;
-        new_node->right = nil;
-        new_node->color = RED;
+    // Вставка с перемещением значения в узел
+    void insert(T&& value) {
+        insert_from(root, std::move(value));
+    }
 
-        // Привязываем новый узел к дереву
-        if (y == nil) {
-            root = new_node;
-        } else if (value < y->data) {
-            y->left = new_node;
-        } else {
-            y->right = new_node;
-        }
+    // Собирает значение из аргументов; true, если оно новое
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        return insert_from(root, T(std::forward<Args>(args)...)).second;
+    }
 
-        // Балансируем дерево
-        fix_insert(new_node);
+    // Вставка перед подсказкой hint: если подсказка верна, спуска от корня нет
+    template <typename... Args>
+    Iterator emplace_hint(Iterator hint, Args&&... args) {
+        T value(std::forward<Args>(args)...);
+        Node* start = hint_start(hint.node, value);
+        return Iterator(insert_from(start, std::move(value)).first, this);
+    }
+
+    // Заменяет содержимое ключами из отсортированного диапазона за O(n)
+    template <typename InputIt>
+    void assign_sorted(InputIt first, InputIt last) {
+        rebuild(sorted_unique(first, last), 1);
+    }
+
+    // То же, но верхние уровни дерева строятся параллельно в threads потоках
+    template <typename InputIt>
+    void assign_sorted_parallel(InputIt first, InputIt last,
+                                unsigned threads = std::thread::hardware_concurrency()) {
+        rebuild(sorted_unique(first, last), threads);
     }
 
     // Удаление элемента из множества
@@ -365,23 +867,72 @@ public:
         }
     }
 
-    // Поиск элемента в множестве
-    bool contains(const T& value) const {
+    // Поиск элемента в множестве; ключ может быть любого типа, сравнимого с T
+    // (например, std::string_view для Set<std::string>) - временный T не создаётся
+    template <typename K>
+    bool contains(const K& value) const {
         return find_node(value) != nil;
     }
 
+    // Первый элемент не меньше value, за O(log n)
+    template <typename K>
+    Iterator lower_bound(const K& value) const {
+        return Iterator(bound_node(value, false), this);
+    }
+
+    // Первый элемент строго больше value, за O(log n)
+    template <typename K>
+    Iterator upper_bound(const K& value) const {
+        return Iterator(bound_node(value, true), this);
+    }
+
+    // Диапазон элементов, равных value (в множестве - не больше одного)
+    template <typename K>
+    std::pair<Iterator, Iterator> equal_range(const K& value) const {
+        return {lower_bound(value), upper_bound(value)};
+    }
+
+    // Количество элементов в [lo, hi). Размеров поддеревьев в узлах нет,
+    // поэтому после спуска к lo элементы диапазона проходятся: O(log n + k)
+    template <typename K>
+    std::size_t count_range(const K& lo, const K& hi) const {
+        std::size_t count = 0;
+        for (Node* node = bound_node(lo, false); node != nil && node->data < hi; node = successor(node)) {
+            ++count;
+        }
+        return count;
+    }
+
+    // Сохраняет дерево в файл в формате SetFileHeader; false при ошибке записи
+    bool save(const std::string& path) const {
+        static_assert(std::is_trivially_copyable<T>::value, "в файл пишутся только тривиально копируемые ключи");
+        std::vector<SetFileNode<T>> nodes;
+        SetFileHeader header{};
+        std::memcpy(header.magic, "RBSET01", 8);
+        header.key_size = sizeof(T);
+        header.node_size = sizeof(SetFileNode<T>);
+        header.root = flatten(root, nodes);
+        header.count = nodes.size();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(SetFileNode<T>));
+        return static_cast<bool>(out.flush());
+    }
+
+    // Открывает сохранённое множество без чтения: файл отображается в память
+    static MappedSet<T> open_mapped(const std::string& path) {
+        return MappedSet<T>(path);
+    }
+
     // Итератор на первый элемент (минимальный)
     Iterator begin() const {
-        Node* current = root;
-        while (current != nil && current->left != nil) {
-            current = current->left;
-        }
-        return Iterator(current, nil);
+        return Iterator(minimum(root), this);
     }
 
     // Итератор на элемент после последнего
     Iterator end() const {
-        return Iterator(nil, nil);
+        return Iterator(nil, this);
     }
 
     bool empty() const {
@@ -415,5 +966,44 @@ int main() {
     }
     std::cout << std::endl;
 
+    // Запросы по диапазону и обход в обратном порядке
+    std::cout << "Элементов в [3, 12): " << s.count_range(3, 12)
+              << ", первый > 7: " << *s.upper_bound(7) << std::endl;
+    std::cout << "В обратном порядке: ";
+    for (auto it = s.end(); it != s.begin();) {
+        --it;
+        std::cout << *it << " ";
+    }
+    std::cout << std::endl;
+
+    // Загрузка отсортированных данных без вставок по одному
+    std::vector<int> sorted;
+    for (int i = 0; i < 1000; ++i) {
+        sorted.push_back(i * 3);
+    }
+    Set<int> loaded(sorted.begin(), sorted.end());
+    std::cout << "Содержит 300: " << loaded.contains(300) << std::endl;
+
+    loaded.assign_sorted_parallel(sorted.begin(), sorted.begin() + 10, 4);
+    std::cout << "После загрузки: ";
+    for (const auto& value : loaded) {
+        std::cout << value << " ";
+    }
+    std::cout << std::endl;
+
+    // Сохранение в файл и мгновенное открытие через mmap
+    if (loaded.save("set.bin")) {
+        MappedSet<int> mapped = Set<int>::open_mapped("set.bin");
+        std::cout << "Из файла, содержит 9: " << mapped.contains(9) << ", всего: " << mapped.size() << std::endl;
+        std::remove("set.bin");
+    }
+
+    // Строки: вставка с перемещением и поиск по string_view без выделения памяти
+    Set<std::string> names;
+    names.emplace("alice");
+    names.insert(std::string("bob"));
+    names.emplace_hint(names.end(), "carol");
+    std::cout << "Есть bob: " << names.contains(std::string_view("bob")) << std::endl;
+
     return 0;
 }